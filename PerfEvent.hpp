@@ -73,6 +73,7 @@ struct PerfEvent {
       registerCounter("LLC-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
       registerCounter("branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
       registerCounter("task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+      registerCounter("dTLB-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16));
       // additional counters can be found in linux/perf_event.h
 
       for (unsigned i=0; i<events.size(); i++) {
@@ -80,9 +81,10 @@ struct PerfEvent {
          event.fd = syscall(__NR_perf_event_open, &event.pe, 0, -1, -1, 0);
          if (event.fd < 0) {
             std::cerr << "Error opening counter " << names[i] << std::endl;
-            events.resize(0);
-            names.resize(0);
-            return;
+            // not all CPUs have e.g. dTLB counters, keep the others
+            events.erase(events.begin() + i);
+            names.erase(names.begin() + i);
+            i--;
          }
       }
    }
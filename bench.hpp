@@ -16,7 +16,10 @@ struct BenchmarkQuery {
 	Program* prog = nullptr;
 	std::shared_ptr<relalg::RelOp> root;
 
-	std::string result = "";
+	//! File with the expected result, empty if there is none
+	std::string result_file = "";
+	//! Fingerprint of 'result_file', see ResultFingerprint
+	std::string result_fingerprint = "";
 
 	/* Annotates pipeline with a price in percent of total cost
 	 * This is needed for explorer when exploring per-pipeline
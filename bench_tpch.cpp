@@ -33,21 +33,6 @@ get_result_file(const std::string& query, QueryConfig& qconf)
 	return Build::BinaryDir() + "/test_results/" + std::to_string(qconf.scale_factor) + "/" + query + ".result";
 }
 
-static bool
-get_result_from_file(std::string& r, const std::string& query, QueryConfig& qconf)
-{
-	const auto file = get_result_file(query, qconf);
-	std::cerr << "Reading result from file '" << file << "' ... ";
-	if (!FileUtils::exists(file)) {
-		std::cerr << "failed" << std::endl;
-		return false;
-	}
-
-	r = FileUtils::read_string_from_file(file);
-	std::cerr << "successful" << std::endl;
-	return true;
-}
-
 #include "bench_tpch_rel.hpp"
 #include "compiler.hpp"
 
@@ -92,11 +77,33 @@ prepare_tpch_query(QueryConfig& qconf, const std::string& q)
 
 	BenchmarkQuery bq = (*it->second)(qconf);
 
-	std::string str;
-	if (get_result_from_file(str, q, qconf)) {
-		bq.result = str;
-		ASSERT(bq.result.size() > 0);
+	// the result itself is only read, when the fingerprint does not match
+	const auto file = get_result_file(q, qconf);
+	std::cerr << "Reading result from file '" << file << "' ... ";
+	if (FileUtils::exists(file)) {
+		bq.result_file = file;
+		ResultFingerprint fingerprint;
+		if (ResultFingerprint::from_file_cached(fingerprint, file)) {
+			bq.result_fingerprint = fingerprint.to_string();
+		}
+		std::cerr << "successful" << std::endl;
+	} else {
+		std::cerr << "failed" << std::endl;
 	}
 
 	return bq;
 }
+
+void
+check_tpch_params(const QueryConfig& qconf, const std::vector<std::string>& queries)
+{
+	// only the plans declare their parameters
+	QueryConfig conf(qconf);
+	for (auto& q : queries) {
+		auto it = plans.find(q);
+		if (it != plans.end()) {
+			(*it->second)(conf);
+		}
+	}
+	conf.check_params();
+}
@@ -2,6 +2,7 @@
 #define H_BENCH_TPCH
 
 #include <string>
+#include <vector>
 #include "bench.hpp"
 
 namespace runtime {
@@ -12,4 +13,8 @@ void setup_tpch(runtime::Database& db, int sf, const std::string& data_dir);
 
 BenchmarkQuery prepare_tpch_query(QueryConfig& qconf, const std::string& q);
 
+//! Throws std::invalid_argument, if 'qconf' binds parameters, which none of
+//! 'queries' declares, or binds values out of their range
+void check_tpch_params(const QueryConfig& qconf, const std::vector<std::string>& queries);
+
 #endif
\ No newline at end of file
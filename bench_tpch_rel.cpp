@@ -22,6 +22,14 @@ add_num_tuples(QueryConfig& cfg, const std::vector<std::string>& tables)
    	cfg.num_tuples = n;
 }
 
+//! Constant bound at runtime, 'dflt' unless already bound
+static std::shared_ptr<RelExpr>
+make_param(QueryConfig& cfg, const std::string& name, int64_t dflt)
+{
+	cfg.declare_param(name, dflt);
+	return make_shared<Const>(dflt, name);
+}
+
 
 BenchmarkQuery
 tpch_rel_q1(QueryConfig& qconf)
@@ -34,7 +42,7 @@ tpch_rel_q1(QueryConfig& qconf)
 
 	auto select = make_shared<Select>(scan, make_shared<Fun>("<=", expr_vec_t {
 		make_shared<ColId>("lineitem.l_shipdate"),
-		make_shared<Const>(std::to_string(types::Date::castString("1998-09-02").value))
+		make_param(qconf, "q1_shipdate", types::Date::castString("1998-09-02").value)
 	}));
 
 	auto one = std::to_string(types::Numeric<12, 2>::castString("1.00").value);
@@ -104,11 +112,11 @@ _tpch_rel_q6(QueryConfig& qconf, int flavor)
 
 	std::shared_ptr<Select> select;
 
-	auto ge_shipdate = make_shared<Fun>(">=", expr_vec_t { make_shared<ColId>("lineitem.l_shipdate"), make_shared<Const>(c1) });
-	auto lt_shipdate = make_shared<Fun>("<", expr_vec_t { make_shared<ColId>("lineitem.l_shipdate"), make_shared<Const>(c2) });
-	auto lt_quantity = make_shared<Fun>("<", expr_vec_t { make_shared<ColId>("lineitem.l_quantity"), make_shared<Const>(c5) });
-	auto ge_discount = make_shared<Fun>(">=", expr_vec_t { make_shared<ColId>("lineitem.l_discount"), make_shared<Const>(c3) });
-	auto lt_discount = make_shared<Fun>("<=", expr_vec_t { make_shared<ColId>("lineitem.l_discount"), make_shared<Const>(c4) });
+	auto ge_shipdate = make_shared<Fun>(">=", expr_vec_t { make_shared<ColId>("lineitem.l_shipdate"), make_param(qconf, "q6_shipdate_lo", c1) });
+	auto lt_shipdate = make_shared<Fun>("<", expr_vec_t { make_shared<ColId>("lineitem.l_shipdate"), make_param(qconf, "q6_shipdate_hi", c2) });
+	auto lt_quantity = make_shared<Fun>("<", expr_vec_t { make_shared<ColId>("lineitem.l_quantity"), make_param(qconf, "q6_quantity", c5) });
+	auto ge_discount = make_shared<Fun>(">=", expr_vec_t { make_shared<ColId>("lineitem.l_discount"), make_param(qconf, "q6_discount_lo", c3) });
+	auto lt_discount = make_shared<Fun>("<=", expr_vec_t { make_shared<ColId>("lineitem.l_discount"), make_param(qconf, "q6_discount_hi", c4) });
 
 	switch (flavor) {
 	case 0:
@@ -234,8 +242,7 @@ tpch_rel_aggr1a(QueryConfig& qconf)
 BenchmarkQuery
 tpch_rel_q3(QueryConfig& qconf)
 {
-	const auto c1 = std::to_string(types::Date::castString("1995-03-15").value);
-	const auto c2 = std::to_string(types::Date::castString("1995-03-15").value);
+	const auto date = types::Date::castString("1995-03-15").value;
 	const auto one = std::to_string(types::Numeric<12, 2>::castString("1.00").value);
 	const auto zero = std::to_string(types::Numeric<12, 4>::castString("0.00").value);
 
@@ -254,7 +261,7 @@ tpch_rel_q3(QueryConfig& qconf)
 
 	auto orders = make_shared<Select>(_orders, make_shared<Fun>("lt", expr_vec_t {
 		make_shared<ColId>("orders.o_orderdate"),
-		make_shared<Const>(c1)
+		make_param(qconf, "q3_date", date)
 	}));
 
 	auto customerorders = make_shared<HashJoin>(HashJoin::Variant::Join01,
@@ -274,7 +281,7 @@ tpch_rel_q3(QueryConfig& qconf)
 
 	auto lineitem = make_shared<Select>(_lineitem, make_shared<Fun>("gt", expr_vec_t {
 		make_shared<ColId>("lineitem.l_shipdate"),
-		make_shared<Const>(c2)
+		make_param(qconf, "q3_date", date)
 	}));
 
 
@@ -850,7 +857,7 @@ tpch_rel_imv1(QueryConfig& qconf)
 
 	orders = make_shared<Select>(orders, make_shared<Fun>("lt", expr_vec_t {
 		make_shared<ColId>("orders.o_orderdate"),
-		make_shared<Const>(constraint_date)
+		make_param(qconf, "imv1_orderdate", constraint_date)
 	}));
 
 	shared_ptr<RelOp> lineitem = make_shared<Scan>("lineitem", RelExpr::from_column_names({
@@ -861,7 +868,7 @@ tpch_rel_imv1(QueryConfig& qconf)
 
 	lineitem = make_shared<Select>(lineitem, make_shared<Fun>("lt", expr_vec_t {
 		make_shared<ColId>("lineitem.l_quantity"),
-		make_shared<Const>(constraint_quant)
+		make_param(qconf, "imv1_quantity", constraint_quant)
 	}));
 
 	shared_ptr<RelOp> join = make_shared<HashJoin>(HashJoin::Variant::Join01,
@@ -45,7 +45,8 @@ def syscall(cmd, time_out_seconds=5*60):
 	return output
 
 
-def run(flavor=None, hot_runs=None, queries=None, no_run=None, scale_factor=None,):
+def run(flavor=None, hot_runs=None, queries=None, no_run=None, scale_factor=None,
+		num_threads=None, default_blend=None, tiered=None):
 	assert(flavor is not None)
 
 	cmd = get_main_executable()
@@ -60,5 +61,11 @@ def run(flavor=None, hot_runs=None, queries=None, no_run=None, scale_factor=None
 		cmd = "{} --no-run".format(cmd)
 	if scale_factor is not None:
 		cmd = "{} --scale_factor={}".format(cmd, scale_factor)
+	if num_threads is not None:
+		cmd = "{} --num_threads={}".format(cmd, num_threads)
+	if default_blend is not None:
+		cmd = "{} --default_blend=\"{}\"".format(cmd, default_blend)
+	if tiered is not None and tiered:
+		cmd = "{} --tiered".format(cmd)
 
 	return syscall(cmd)
\ No newline at end of file
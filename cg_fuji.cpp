@@ -483,13 +483,7 @@ FujiCodegen::_gen(ExprPtr& e, bool pred)
 
 			s	<< at_begin << EOL
 				<< "if (!m_global_aggr_bucket) {" << EOL
-				<< "  auto table = " << "thread." << tbl << ";" << EOL
-				<< "  Block* block = table->hash_append_prealloc<false>(1);" << EOL
-				<< "  char* new_bucket = block->data + (block->width * block->num);" << EOL
-				<< "  void** buckets = table->get_hash_index();" << EOL
-				<< "  buckets[0] = new_bucket;" << EOL
-				<< "  table->hash_append_prune<false>(block, 1);" << EOL
-				<< "  m_global_aggr_bucket = new_bucket; " << EOL
+				<< "  m_global_aggr_bucket = thread." << tbl << "->new_global_row();" << EOL
 				// << "  printf(\"" << e.fun << ": index=%lu count=%lu bucket=%lu mask=%lu\\n\", index, table->count, table->buckets[index], table->bucket_mask);" << EOL
 				<< "  LOG_TRACE(\"Bucket %p\\n\", m_global_aggr_bucket);" << EOL
 				<< "}" << EOL
@@ -22,6 +22,10 @@ struct FujiCodegen : Codegen {
 	void gen_pipeline(Pipeline& p, size_t number) override;
 	void gen_lolepop(Lolepop& l, Pipeline& p) override;
 
+	//! Concurrent FSMs get the next morsel, while others still process
+	//! rows, as do buffers between blends
+	bool finishes_morsel_before_next() const override { return false; }
+
 	// expression cache
 	std::unordered_map<ExprPtr, DataGenExprPtr> exprs;
 
@@ -767,37 +767,80 @@ Avx512DataGen::gen(ExprPtr& e, bool pred)
 				has_result = false;
 				new_variable = false;
 
-				unrolled(statements, e, [&] (int k) {
-					clite::ExprPtr val;
-
-					std::string type;
-
+				// lanes can hit the same group, SIMD_TABLE_AGGREGATE resolves
+				// such conflicts, but only handles 32/64-bit columns
+				bool simd = unroll == 8 && type_is_native(res_type0_code) &&
+					(bits == 32 || bits == 64);
+				std::string val_type("u64");
+				clite::ExprPtr values;
+
+				if (simd) {
 					if (!n.compare("aggr_count")) {
-						type = "COUNT";
-						val = one;
+						values = factory.function("_mm512_set1_epi64", one);
 					} else {
-						val = read_arg(e->args[2], k);
-						if (!n.compare("aggr_sum")) {
-							type = "SUM";
-						} else if (n == "aggr_min") {
-						type = "MIN";
-						} else if (n == "aggr_max") {
-							type = "MAX";
+						auto& arg = e->args[2];
+						val_type = arg->props.type.arity[0].type;
+						simd = type_is_native(type_code_from_str(val_type));
+						values = factory.reference(get(arg)->var);
+					}
+				}
+
+				if (simd) {
+					std::string op;
+					if (!n.compare("aggr_count") || !n.compare("aggr_sum")) {
+						op = "kSimdAggrSum";
+					} else if (n == "aggr_min") {
+						op = "kSimdAggrMin";
+					} else if (n == "aggr_max") {
+						op = "kSimdAggrMax";
+					} else {
+						ASSERT(false);
+					}
+
+					statements.emplace_back(factory.effect(factory.function("SIMD_TABLE_AGGREGATE", {
+						access_table(tbl),
+						factory.literal_from_str(op),
+						factory.literal_from_str(get_row_type(tbl)),
+						factory.literal_from_str(col),
+						factory.literal_from_str(val_type),
+						get_pred_mask(),
+						factory.reference(get(idx)->var),
+						values
+					})));
+				} else {
+					unrolled(statements, e, [&] (int k) {
+						clite::ExprPtr val;
+
+						std::string type;
+
+						if (!n.compare("aggr_count")) {
+							type = "COUNT";
+							val = one;
 						} else {
-							ASSERT(false);
+							val = read_arg(e->args[2], k);
+							if (!n.compare("aggr_sum")) {
+								type = "SUM";
+							} else if (n == "aggr_min") {
+								type = "MIN";
+							} else if (n == "aggr_max") {
+								type = "MAX";
+							} else {
+								ASSERT(false);
+							}
 						}
-					}
 
-					clite::ExprPtr col_data = factory.cast(get_row_type(tbl) + "*", read_arg(idx, k)); 
+						clite::ExprPtr col_data = factory.cast(get_row_type(tbl) + "*", read_arg(idx, k)); 
 
-					return clite::StmtList { factory.effect(factory.function("SCALAR_AGGREGATE", {
-						factory.literal_from_str(type),
-						factory.function("ACCESS_ROW_COLUMN",
-							col_data,
-							factory.literal_from_str("col_" + col)),
-						val
-					})) };
-				});
+						return clite::StmtList { factory.effect(factory.function("TABLE_AGGREGATE", {
+							access_table(tbl),
+							factory.literal_from_str(type),
+							factory.function("ACCESS_ROW_COLUMN",
+								col_data,
+								factory.literal_from_str("col_" + col)),
+							val
+						})) };
+					});
+				}
 
 				match = true;
 			} else {
@@ -980,19 +1023,14 @@ Avx512DataGen::gen(ExprPtr& e, bool pred)
 
 				if (!match && !n.compare("bucket_lookup")) {
 					auto mask = get_pred_mask();
-					auto source = new_zero_source(64);
 					const auto& idx = get(e->args[1])->var;
 
 					auto hmask = factory.reference(get_hash_mask_var(tbl));
 					auto hindex = factory.reference(get_hash_index_var(tbl));
 
-					auto buckets = factory.function("_mm512_and_epi64", factory.function("_mm512_set1_epi64", hmask),
-						factory.function("SIMD_GET_IVEC", factory.reference(idx)));
-
-					statements.emplace_back(factory.effect(factory.function("_v512_from",
-						factory.reference(dest_var),
-						factory.function("_mm512_mask_i64gather_epi64", 
-							{ source, mask, buckets, hindex, factory.literal_from_str("sizeof(u64)") }))));
+					statements.emplace_back(factory.effect(factory.function("SIMD_BUCKET_LOOKUP", {
+						factory.reference(dest_var), access_table(tbl), mask,
+						factory.reference(idx), hindex, hmask })));
 
 					ASSERT(tpe.size() > 0);
 					match = true;
@@ -1000,26 +1038,30 @@ Avx512DataGen::gen(ExprPtr& e, bool pred)
 
 				if (!match && !n.compare("bucket_next")) {
 					auto mask = get_pred_mask();
-					auto source = new_zero_source(64);
 					const auto& idx = get(e->args[1])->var;
 
-					auto offset = factory.function("SIMD_TABLE_NEXT_OFFSET",
-						access_table(tbl));
-					auto ptrs = factory.function("_mm512_add_epi64",
-						factory.function("SIMD_GET_IVEC", factory.reference(idx)),
-						factory.function("_mm512_set1_epi64", offset));
-
-					auto gather = factory.function("_mm512_mask_i64gather_epi64", {
-						source, mask, ptrs, null, one
-					});
+					auto hmask = factory.reference(get_hash_mask_var(tbl));
+					auto hindex = factory.reference(get_hash_index_var(tbl));
 
-					statements.emplace_back(factory.effect(
-						factory.function("_v512_from", factory.reference(dest_var), gather)));
+					statements.emplace_back(factory.effect(factory.function("SIMD_BUCKET_NEXT", {
+						factory.reference(dest_var), access_table(tbl), mask,
+						factory.reference(idx), hindex, hmask })));
 
 					ASSERT(tpe.size() > 0);
 					match = true;
 				}
 
+				if (!match && !n.compare("bucket_link")) {
+					const auto& idx = get(e->args[1])->var;
+
+					statements.emplace_back(factory.effect(factory.function("SIMD_BUCKET_LINK", {
+						access_table(tbl), get_pred_mask(), factory.reference(idx) })));
+
+					has_result = false;
+					new_variable = false;
+					match = true;
+				}
+
 				if (!match && !n.compare("bucket_insert")) {
 					auto& idx = e->args[1];
 
@@ -1082,7 +1124,7 @@ Avx512DataGen::gen(ExprPtr& e, bool pred)
 	}
 
 	if (!match && e->type == Expression::Constant) {
-		auto constant = e->fun;
+		auto constant = Codegen::gen_constant(*e);
 		const auto& type = e->props.type.arity[0].type;
 		bool is_string = !type.compare("varchar");
 
@@ -1276,13 +1318,14 @@ Avx512DataGen::gen(ExprPtr& e, bool pred)
 	// assume some function
 	if (!match) {
 		printf("tpe=%s res0 %s\n", tpe.c_str(), res_type0.c_str());
+		const std::string fun(n == "div" ? "voila_div" : e->fun);
 		unrolled(statements, e, [&] (int k) {
 			clite::ExprList args;
 			for (size_t i=0; i<e->args.size(); i++) {
 				args.emplace_back(read_arg(e->args[i], k));
 			}
 
-			auto r = factory.function(e->fun, args);
+			auto r = factory.function(fun, args);
 			return clite::StmtList { write_arg(tpe, res_type0, dest_var, k, r) };
 
 		});
@@ -1427,6 +1470,12 @@ Avx512DataGen::gen_extra(clite::StmtList& stmts, ExprPtr& e)
 		} else if (n == "aggr_gsum") {
 			agg_type = "SUM";
 			comb_type = "SUM";
+		} else if (n == "aggr_gmin") {
+			agg_type = "MIN";
+			comb_type = "MIN";
+		} else if (n == "aggr_gmax") {
+			agg_type = "MAX";
+			comb_type = "MAX";
 		} else {
 			ASSERT(false);
 		}
@@ -392,7 +392,7 @@ DataGen::can_prefetch(const ExprPtr& e)
 	if (e->is_aggr() || str_in_strings(e->fun, {
 		"bucket_lookup", "bucket_next" , "gather", "check"})) {
 
-		if (!str_in_strings(e->fun, {"aggr_gcount", "aggr_gsum"})) {
+		if (!str_in_strings(e->fun, {"aggr_gcount", "aggr_gsum", "aggr_gmin", "aggr_gmax"})) {
 			return DataGen::PrefetchType::PrefetchBefore;
 		}
 	}
@@ -452,26 +452,22 @@ DataGen::new_global_aggregate(const std::string& tpe,
 {
 	clite::Factory factory;
 	auto id = unique_id();
+	const std::string neutral(comb_type.empty() ?
+		"0" : "AGGR_NEUTRAL_" + comb_type + "(" + tpe + ")");
 	auto acc = get_fragment().new_var(id, tpe,
-		clite::Variable::Scope::ThreadWide, false, "0");
+		clite::Variable::Scope::ThreadWide, false, neutral);
 	
 	if (!comb_type.empty()) {
 		ASSERT(m_codegen.global_agg_bucket);
 		auto fetched = access_column(tbl, kColPrefix + col,
 			m_codegen.global_agg_bucket);
 
-		auto hash = access_column(tbl, "hash",
-			m_codegen.global_agg_bucket);
-
-		m_codegen.at_fin.push_back(factory.assign(hash,
-			factory.literal_from_str(std::to_string(kGlobalAggrHashVal))));
-
 		m_codegen.at_fin.push_back(factory.effect(
 			factory.function("SCALAR_AGGREGATE",
 				factory.literal_from_str(comb_type), fetched, factory.reference(acc)
 			)
 		));			
-		m_codegen.at_fin.push_back(factory.assign(acc, factory.literal_from_str("0")));
+		m_codegen.at_fin.push_back(factory.assign(acc, factory.literal_from_str(neutral)));
 	}
 
 	return acc;
@@ -133,7 +133,7 @@ ScalarDataGen::gen(ExprPtr& e, bool pred)
 	clite::Factory factory;
 
 	if (!match && e->type == Expression::Constant) {
-		auto constant = e->fun;
+		auto constant = Codegen::gen_constant(*e);
 		const auto& type = e->props.type.arity[0].type;
 		const bool is_string = !type.compare("varchar");
 
@@ -285,9 +285,10 @@ ScalarDataGen::gen(ExprPtr& e, bool pred)
 				ASSERT(false);
 			}
 			statements.emplace_back(factory.effect(
-					factory.function("SCALAR_AGGREGATE",
+					factory.function("TABLE_AGGREGATE", {
+						access_table(tbl),
 						factory.literal_from_str(type), fetched, factory.reference(arg)
-					)
+					})
 				));
 			new_variable = false;
 			match = true;
@@ -363,13 +364,31 @@ ScalarDataGen::gen(ExprPtr& e, bool pred)
 			if (!match && !n.compare("bucket_next")) {
 				auto index = get_bucket_index_expr(e);
 
+				auto hash_index = get_hash_index_var(tbl);
+				auto hash_mask = get_hash_mask_var(tbl);
+
 				// statements.emplace_back(factory.log_debug("bucket_next", {}));
 				statements.emplace_back(factory.assign(dest_var,
-					access_column(tbl, "next", get_bucket_index_expr(e))));
+					factory.function("SCALAR_BUCKET_NEXT", {
+						access_table(tbl),
+						index,
+						factory.reference(hash_index),
+						factory.reference(hash_mask)
+					})));
 
 				match = true;
 			}
 
+			if (!match && !n.compare("bucket_link")) {
+				statements.emplace_back(factory.effect(
+					factory.function("SCALAR_BUCKET_LINK",
+						access_table(tbl),
+						factory.reference(expr2get0(e->args[1])))));
+
+				match = true;
+				new_variable = false;
+			}
+
 			if (!match && !n.compare("bucket_lookup")) {
 				auto index = factory.reference(expr2get0(e->args[1]));
 
@@ -438,8 +457,9 @@ ScalarDataGen::gen(ExprPtr& e, bool pred)
 			args.emplace_back(factory.reference(get(a)->var));
 		}
 
+		const std::string fun(n == "div" ? "voila_div" : e->fun);
 		statements.emplace_back(factory.assign(dest_var,
-			factory.function( e->fun,args)));
+			factory.function(fun, args)));
 
 		match = true;
 	}
@@ -555,6 +575,12 @@ ScalarDataGen::gen_extra(clite::StmtList& stmts, ExprPtr& e)
 		} else if (n == "aggr_gsum") {
 			agg_type = "SUM";
 			comb_type = "SUM";
+		} else if (n == "aggr_gmin") {
+			agg_type = "MIN";
+			comb_type = "MIN";
+		} else if (n == "aggr_gmax") {
+			agg_type = "MAX";
+			comb_type = "MAX";
 		} else {
 			ASSERT(false);
 		}
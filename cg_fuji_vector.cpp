@@ -559,7 +559,7 @@ VectorDataGen::gen(ExprPtr& e, bool pred)
 		dest_var = new_dest(res_type0, true);
 		dest_num = const_vector_size();
 
-		std::string value(e->fun);
+		std::string value(Codegen::gen_constant(*e));
 
 		if (res_type0 == "varchar") {
 			value = "\"" + value + "\"";
@@ -797,6 +797,12 @@ VectorDataGen::gen_extra(clite::StmtList& stmts, ExprPtr& e)
 		} else if (n == "aggr_gsum") {
 			agg_type = "aggr_direct_gsum";
 			comb_type = "SUM";
+		} else if (n == "aggr_gmin") {
+			agg_type = "aggr_direct_gmin";
+			comb_type = "MIN";
+		} else if (n == "aggr_gmax") {
+			agg_type = "aggr_direct_gmax";
+			comb_type = "MAX";
 		} else {
 			ASSERT(false);
 		}
@@ -183,44 +183,48 @@ HyperCodegen::gen(GenCtx& ctx, Expression& e)
 		bool is_global_aggr = false;
 		bool is_aggr = e.is_aggr(&is_global_aggr);
 		if (is_global_aggr) {
+			const auto& acc_type = e.props.type.arity[0].type;
 			auto acc = unique_id();
-			new_decl(e.props.type.arity[0].type, acc);
 
+			std::string type;
 			if (!e.fun.compare("aggr_gcount")) {
-				predicated << acc << "++;";
+				type = "COUNT";
 			} else if (!e.fun.compare("aggr_gsum")) {
-				auto arg = expr2get0(e.args[1]);
-				predicated << acc << " += " << arg << ";";
+				type = "SUM";
+			} else if (!e.fun.compare("aggr_gmin")) {
+				type = "MIN";
+			} else if (!e.fun.compare("aggr_gmax")) {
+				type = "MAX";
 			} else {
 				ASSERT(false);
 			}
 
+			new_decl(acc_type, acc, " = AGGR_NEUTRAL_" + type + "(" + acc_type + ")");
+
+			if (!e.fun.compare("aggr_gcount")) {
+				predicated << acc << "++;";
+			} else {
+				auto arg = expr2get0(e.args[1]);
+				predicated << "AGGR_" << type << "(" << acc << ", " << arg << ");";
+			}
+
 			if (!pipeline_end_gen) {
 				pipeline_end
 					<< "u64 pipeline_end_bucket_id = 0;" << EOL
 					<< "{" << EOL
-					<< "  auto table = " << "thread." << tbl << ";" << EOL
-					<< "  Block* block = table->hash_append_prealloc<false>(1);" << EOL
-					<< "  char* new_bucket = block->data + (block->width * block->num);" << EOL
-					<< "  void** buckets = table->get_hash_index();" << EOL
-					<< "  buckets[0] = new_bucket;" << EOL
-					<< "  table->hash_append_prune<false>(block, 1);" << EOL
-					<< "  pipeline_end_bucket_id = (u64)new_bucket; " << EOL
+					<< "  pipeline_end_bucket_id = (u64)thread." << tbl << "->new_global_row();" << EOL
 					// << "  printf(\"" << e.fun << ": index=%lu count=%lu bucket=%lu mask=%lu\\n\", index, table->count, table->buckets[index], table->bucket_mask);" << EOL
 					<< "}" << EOL
 					<< "LOG_TRACE(\"Bucket %p\\n\", pipeline_end_bucket_id);" << EOL
 					;
-
-				pipeline_end
-					<< access_raw_column(tbl, "hash", "pipeline_end_bucket_id")
-						<< " = " << kGlobalAggrHashVal << ";" << EOL;
 			}
 
 			pipeline_end_gen = true;
 			pipeline_end << "{" << EOL
 				<< "/* propagate " << e.fun << " to table */" << EOL 
 				<< "LOG_TRACE(\"propagate %d\\n\", " << acc << ");" << EOL
-				<< access_column(tbl, col, "pipeline_end_bucket_id") << " += " << acc << ";" << EOL
+				<< "SCALAR_AGGREGATE(" << (type == "COUNT" ? "SUM" : type) << ", "
+					<< access_column(tbl, col, "pipeline_end_bucket_id") << ", " << acc << ");" << EOL
 				<< "}" << EOL;
 			expr2set0(&e, "AGGR-HAS-NO-RESULT");
 			// ASSERT(false && "todo");
@@ -231,19 +235,23 @@ HyperCodegen::gen(GenCtx& ctx, Expression& e)
 			predicated << "auto &aggr = " << access_column(tbl, col, expr2get0(e.args[1])) << ";" << EOL;
 
 
+			// atomic on tables shared by all threads
 			if (!e.fun.compare("aggr_count")) {
-				predicated << "aggr++;";
+				predicated << "TABLE_AGGREGATE(thread." << tbl << ", COUNT, aggr, 1);";
 			} else {
 				auto arg = expr2get0(e.args[2]);
+				std::string type;
 				if (!e.fun.compare("aggr_sum")) {
-					predicated << "aggr += " << arg << ";";
+					type = "SUM";
 				} else if (!e.fun.compare("aggr_min")) {
-					predicated << "if (" << arg << " < aggr) aggr = " << arg <<";";
+					type = "MIN";
 				} else if (!e.fun.compare("aggr_max")) {
-					predicated << "if (" << arg << " > aggr) aggr = " << arg <<";";
+					type = "MAX";
 				} else {
 					ASSERT(false);
 				}
+				predicated << "TABLE_AGGREGATE(thread." << tbl << ", " << type
+					<< ", aggr, " << arg << ");";
 			}
 			predicated << EOL;
 			predicated << "}" << EOL;			
@@ -308,8 +316,10 @@ HyperCodegen::gen(GenCtx& ctx, Expression& e)
 			if (!match && !e.fun.compare("bucket_lookup")) {
 				std::string index = expr2get0(e.args[1]);
 				new_decl(e.props.type.arity[0].type, id);
-				predicated << id <<" = (u64)"
-					<< access_table(tbl) << "->get_hash_index()[" << index << " & " << access_table(tbl) << "->get_hash_index_mask()];" << EOL;
+				predicated << id <<" = SCALAR_BUCKET_LOOKUP("
+					<< access_table(tbl) << ", " << index << ", "
+					<< access_table(tbl) << "->get_hash_index(), "
+					<< access_table(tbl) << "->get_hash_index_mask());" << EOL;
 				// predicated << "printf(\"" << e.fun << ": %p\\n\", " << id << ");" << EOL;
 				match = true;
 			}
@@ -317,7 +327,10 @@ HyperCodegen::gen(GenCtx& ctx, Expression& e)
 			if (!match && !e.fun.compare("bucket_next")) {
 				std::string index = expr2get0(e.args[1]);
 				new_decl(e.props.type.arity[0].type, id);
-				predicated << id <<" = " << access_raw_column(tbl, "next", index) << ";" << EOL;
+				predicated << id <<" = SCALAR_BUCKET_NEXT("
+					<< access_table(tbl) << ", " << index << ", "
+					<< access_table(tbl) << "->get_hash_index(), "
+					<< access_table(tbl) << "->get_hash_index_mask());" << EOL;
 				// predicated << "printf(\" next %p from index %p\\n\", " << id << "," << index << ");" << EOL;
 				match = true;
 			}
@@ -328,21 +341,15 @@ HyperCodegen::gen(GenCtx& ctx, Expression& e)
 
 				// TODO: impl
 				predicated << "LOG_GEN_TRACE(\"" << e.fun << " at " << expr2get0(e.args[1]) << "\\n\");" << EOL;
-				predicated << id << ";" << EOL
-					<< "{" << EOL
-					<< "  auto table = " << access_table(tbl) << ";" << EOL
-					<< "  Block* block = table->hash_append_prealloc<false>(1);" << EOL
-					<< "  char* new_bucket = block->data + (block->width * block->num);" << EOL
-					<< "  auto row = (" << get_row_type(tbl) << "*)new_bucket;" << EOL
-					<< "  const u64 index = (" << index << ") & table->get_hash_index_mask();" << EOL
-					<< "  void** buckets = table->get_hash_index();" << EOL
-					<< "  row->next = (u64)buckets[index];" << EOL
-					// << "  printf(\"block data %p block num %llu new bucket %p old bucket %p\\n\", block->data, block->num, new_bucket, buckets[index]);" << EOL
-					<< "  buckets[index] = new_bucket;" << EOL
-					<< "  table->hash_append_prune<false>(block, 1);" << EOL
-					<< "  " << id << " = (u64)new_bucket; " << EOL
-					// << "  printf(\"" << e.fun << ": index=%lu count=%lu bucket=%lu mask=%lu\\n\", index, table->count, table->buckets[index], table->bucket_mask);" << EOL
-					<< "}" << EOL;
+				predicated << id << " = SCALAR_BUCKET_INSERT("
+					<< access_table(tbl) << ", " << index << ", "
+					<< get_row_type(tbl) << ");" << EOL;
+				match = true;
+			}
+
+			if (!match && !e.fun.compare("bucket_link")) {
+				predicated << "SCALAR_BUCKET_LINK(" << access_table(tbl) << ", "
+					<< expr2get0(e.args[1]) << ");" << EOL;
 				match = true;
 			}
 
@@ -574,6 +581,10 @@ HyperCodegen::gen(GenCtx& ctx, Expression& e)
 			break;
 		}
 
+		if (!e.fun.compare("div")) {
+			gen_fun_name = "voila_div";
+		}
+
 		if (!e.fun.compare("hash") || !e.fun.compare("rehash")) {
 			size_t idx = 0;
 			if (!e.fun.compare("rehash")) {
@@ -604,7 +615,7 @@ HyperCodegen::gen(GenCtx& ctx, Expression& e)
 			if (!type.compare("varchar")) {
 				new_decl(type, id, "(\"" + e.fun + "\")", "const ");
 			} else {
-				new_decl(type, id, "(" + e.fun + ")", "const ");
+				new_decl(type, id, "(" + gen_constant(e) + ")", "const ");
 			}
 #if 0
 			predicated << id <<" = ";
@@ -760,12 +771,7 @@ HyperCodegen::gen(GenCtx& ctx, Statement& e)
 					size_t i=0;
 					code << "query.result.begin_line();" << EOL;
 					for (auto& c : expr2var[e.expr.get()]) {
-						code << "{" << EOL
-							<< "size_t buffer_size = voila_cast<" << e.expr->props.type.arity[i].type << ">::good_buffer_size();" << EOL
-							<< "char* str; char buffer[buffer_size];" << EOL
-							<< "buffer_size = voila_cast<" << e.expr->props.type.arity[i].type << ">::to_cstr(str, &buffer[0], buffer_size, " << c << ");" << EOL
-							<< "query.result.push_col(str, buffer_size);" << EOL
-							<< "}" << EOL;
+						code << "query.result.push<" << e.expr->props.type.arity[i].type << ">(" << c << ");" << EOL;
 						i++;
 					}
 					code << "query.result.end_line();" << EOL;
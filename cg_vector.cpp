@@ -442,13 +442,7 @@ VectorCodegen::gen(GenCtx& ctx, Expression& e)
 			}
 			if (global_aggr) {
 				next << "if (!global_aggr_allocated) {"
-					<< "  auto table = " << "thread." << tbl << ";" << EOL
-					<< "  Block* block = table->hash_append_prealloc<false>(1);" << EOL
-					<< "  void** buckets = table->get_hash_index();" << EOL
-					<< "  char* new_bucket = block->data + (block->width * block->num);" << EOL
-					<< "  buckets[0] = new_bucket;" << EOL
-					<< "  table->hash_append_prune<false>(block, 1);" << EOL
-					<< "  global_aggr_allocated = (void*)new_bucket; " << EOL
+					<< "  global_aggr_allocated = (void*)thread." << tbl << "->new_global_row();" << EOL
 					<< "  LOG_TRACE(\"global_aggr_allocated = %p\\n\", global_aggr_allocated);"
 					<< "}"
 					;
@@ -528,7 +522,10 @@ VectorCodegen::gen(GenCtx& ctx, Expression& e)
 			ASSERT(e.props.type.arity.size() == 1 && "Must be scalar");
 
 			const auto& num = const_vector_size();
-			auto id = new_expr("VecConst", translate_type(e.props.type.arity[0].type), e.fun, "");
+			const auto type = translate_type(e.props.type.arity[0].type);
+			auto id = e.is_param() ?
+				new_expr2("VecConst", type, "std::to_string(" + gen_constant(e, "p.query") + ")", "") :
+				new_expr("VecConst", type, e.fun, "");
 
 			expr2num[&e] = num;
 			expr2set0(&e, id);
@@ -6,6 +6,8 @@
 #include "printing_pass.hpp"
 #include "codegen_passes.hpp"
 #include <sstream> 
+#include <algorithm>
+#include <map>
 #include "common/runtime/Types.hpp"
 
 CgBaseCol::CgBaseCol(const std::string& source, runtime::Attribute& a)
@@ -18,6 +20,23 @@ CgBaseCol::CgBaseCol(const std::string& source, runtime::Attribute& a)
 	maxlen = a.minmax->max_len;
 }
 
+//! Collects the query parameters of a program with their types
+struct CollectParamsPass : Pass {
+	std::map<std::string, std::string> params;
+
+	CollectParamsPass() {
+		flat = true;
+	}
+
+	void on_expression(LolepopCtx& ctx, ExprPtr& e) override {
+		if (e->is_param()) {
+			ASSERT(e->props.type.arity.size() == 1 && "Must be scalar");
+			params[e->param] = e->props.type.arity[0].type;
+		}
+		recurse_expression(ctx, e);
+	}
+};
+
 Codegen::Codegen(QueryConfig& config)
  : config(config)
 {
@@ -116,6 +135,15 @@ Codegen::gen_table(std::ostringstream& out, DataStructure& d,
 	out << "}; /* Row */" << std::endl
 		<< "Row* rows = nullptr;" << std::endl;
 
+	const bool shared = t == DataStructure::Type::kHashTable &&
+		!(d.flags & DataStructure::kThreadLocal);
+
+	if (t == DataStructure::Type::kHashTable) {
+		out << "static constexpr bool kOpenAddressing = "
+			<< bool2str(d.flags & DataStructure::kOpenAddressing) << ";" << std::endl
+			<< "static constexpr bool kShared = " << bool2str(shared) << ";" << std::endl;
+	}
+
 	// NSM->DSM row
 	map_keys_first(cols, [&] (auto c, auto is_key) {
 		(void)is_key;
@@ -128,7 +156,11 @@ Codegen::gen_table(std::ostringstream& out, DataStructure& d,
 	out << type << "(Query& q, LogicalMasterTable* master_table, "
 		<< "size_t num_rows) : " << base << "(\"" << id << "\", q, master_table, sizeof(Row), "
 		<< bool2str(d.flags & DataStructure::kThreadLocal) << ", "
-		<< bool2str(d.flags & DataStructure::kFlushToMaster)
+		<< bool2str(d.flags & DataStructure::kFlushToMaster) << ", "
+		<< bool2str(d.flags & DataStructure::kOpenAddressing) << ", "
+		<< d.cardinality << ", "
+		<< bool2str(d.flags & DataStructure::kRadixPartitioned) << ", "
+		<< bool2str(d.flags & DataStructure::kGlobalAggregate)
 		<< ")";
 
 	map_keys_first(cols, [&] (auto c, auto is_key) {
@@ -150,7 +182,8 @@ Codegen::gen_table(std::ostringstream& out, DataStructure& d,
 			<< "offset_" << c.name << " = " << "(char*)&dummy_row.col_" << c.name << " - (char*)&dummy_row;" << std::endl
 			<< "static_assert(sizeof(Row) % sizeof(" << c.type << ") == 0, \"Must be a multiple\");" << std::endl
 			<< "col_" << c.name << ".reset_pointer(offset_" << c.name << ");" << std::endl
-			<< "coldef_" << c.name << ".init(offset_" << c.name << ", stride_" << c.name << ");" << std::endl;
+			<< "coldef_" << c.name << ".init(offset_" << c.name << ", stride_" << c.name << ", "
+				<< bool2str(shared) << ");" << std::endl;
 
 #if 0
 		// test
@@ -191,6 +224,58 @@ Codegen::gen_table(std::ostringstream& out, DataStructure& d,
 
 	out << "}" << std::endl;
 
+	if (t == DataStructure::Type::kHashTable) {
+		out << "bool keys_equal(const char* a, const char* b) const override {" << std::endl
+			<< "const Row* ra = (const Row*)a;" << std::endl
+			<< "const Row* rb = (const Row*)b;" << std::endl
+			<< "return true";
+		map_keys_first(cols, [&] (auto c, auto is_key) {
+			if (is_key) {
+				out << " && ra->col_" << c.name << " == rb->col_" << c.name;
+			}
+		});
+		out << ";" << std::endl
+			<< "}" << std::endl;
+	}
+
+	if (d.flags & DataStructure::kGlobalAggregate) {
+		std::string count_col;
+		for (auto& c : cols) {
+			if (!c.combine.compare("count")) {
+				count_col = "col_" + c.name;
+			}
+		}
+		ASSERT(count_col.size() > 0);
+
+		out << "void combine_rows(char* dst, const char* src) const override {" << std::endl
+			<< "Row* d = (Row*)dst;" << std::endl
+			<< "const Row* s = (const Row*)src;" << std::endl
+			<< "if (!s->" << count_col << ") { return; }" << std::endl
+			<< "if (!d->" << count_col << ") { memcpy(d, s, sizeof(Row)); return; }" << std::endl;
+		for (auto& c : cols) {
+			if (!c.combine.compare("sum") || !c.combine.compare("count")) {
+				out << "d->col_" << c.name << " += s->col_" << c.name << ";" << std::endl;
+			} else if (!c.combine.compare("min")) {
+				out << "AGGR_MIN(d->col_" << c.name << ", s->col_" << c.name << ");" << std::endl;
+			} else if (!c.combine.compare("max")) {
+				out << "AGGR_MAX(d->col_" << c.name << ", s->col_" << c.name << ");" << std::endl;
+			}
+		}
+		out << "}" << std::endl;
+
+		out << "void init_global_row(char* row) const override {" << std::endl
+			<< "Row* r = (Row*)row;" << std::endl
+			<< "(void)r;" << std::endl;
+		for (auto& c : cols) {
+			if (!c.combine.compare("min")) {
+				out << "r->col_" << c.name << " = AGGR_NEUTRAL_MIN(" << c.type << ");" << std::endl;
+			} else if (!c.combine.compare("max")) {
+				out << "r->col_" << c.name << " = AGGR_NEUTRAL_MAX(" << c.type << ");" << std::endl;
+			}
+		}
+		out << "}" << std::endl;
+	}
+
 	out << "}; /* " << id << "*/" << std::endl;
 }
 
@@ -255,11 +340,28 @@ Codegen::operator()(Program& p)
 		gen_datastructure(d, p);
 	}
 
+	// remember which parts of 'init', 'impl' and 'next' belong to which
+	// pipeline, to be able to split them into translation units
+	struct Slice {
+		size_t init;
+		size_t impl;
+		size_t next;
+	};
+
+	auto get_slice = [&] () {
+		return Slice { init.str().size(), impl.str().size(), next.str().size() };
+	};
+
+	std::vector<std::pair<Slice, Slice>> slices;
+
 	size_t num = p.pipelines.size();
 	for (size_t i=0; i<num; i++) {
 		auto& pl = p.pipelines[i];
 		last_pipeline = i+1 == num;
+
+		Slice begin = get_slice();
 		gen_pipeline(pl, i);
+		slices.push_back({ begin, get_slice() });
 	}
 
 	std::ostringstream out;
@@ -276,7 +378,17 @@ Codegen::operator()(Program& p)
 		std::ostringstream thread_ctor;
 		std::ostringstream thread_dtor;
 
-		query_ctor << "  ThisQuery(QueryConfig& cfg) : Query(cfg) {" << std::endl;
+		// parameters are resolved once, generated code reads these members
+		query_ctor << "  ThisQuery(QueryConfig& cfg) : Query(cfg)";
+		CollectParamsPass collect_params;
+		collect_params(p);
+		for (auto& param : collect_params.params) {
+			const std::string member(gen_param_member(param.first));
+			query_decl << "  const " << param.second << " " << member << ";" << std::endl;
+			query_ctor << ", " << member << "(get_param<" << param.second
+				<< ">(\"" << param.first << "\"))";
+		}
+		query_ctor << " {" << std::endl;
 		query_dtor << "  ~ThisQuery() {" << std::endl;
 		thread_ctor << "  ThisThreadLocal(ThisQuery& q) : IThreadLocal(q) {" << std::endl;
 		thread_dtor << "  ~ThisThreadLocal() {" << std::endl;
@@ -300,7 +412,7 @@ Codegen::operator()(Program& p)
 			if (local) {
 				if (flush_to_master) {
 					query_decl << "  LogicalMasterTable* master_" << d.name << ";"  << std::endl;
-					query_ctor << "master_" << d.name << " = new LogicalMasterTable();" << std::endl;	
+					query_ctor << "master_" << d.name << " = new LogicalMasterTable(*this);" << std::endl;	
 					query_dtor << "delete master_" << d.name << ";" << std::endl;
 				}
 			} else {
@@ -331,6 +443,13 @@ Codegen::operator()(Program& p)
 
 				thread_ctor << d.name << " = new "<<  "  " << thread_local_type
 					<< " (q, " << master << ", " << default_struct_args << ")" << ";" << std::endl;
+				if (!d.partitioned_like.empty()) {
+					thread_ctor << d.name << "->m_radix_source = q." << d.partitioned_like << ";" << std::endl;
+				}
+				if (!d.merges.empty()) {
+					thread_ctor << "q.master_" << d.merges << "->add_merge_target(*" << d.name << ", "
+						<< (finishes_morsel_before_next() ? "true" : "false") << ");" << std::endl;
+				}
 				thread_dtor << "delete " << d.name << ";" << std::endl;
 			} else {
 				//if (base_table) {
@@ -360,36 +479,126 @@ Codegen::operator()(Program& p)
 			<< "};" << std::endl;
 	}
 
+	units.header = "#pragma once\n" + out.str();
+
+	auto gen_exports = [&] (std::ostringstream& o, const std::string& new_pipeline) {
+		o << "// main" << std::endl;
+
+		o << "EXPORT Query* voila_query_new(QueryConfig* cfg) {" << std::endl
+			<< "  ASSERT(cfg);" << std::endl
+			<< "  ThisQuery* q = new ThisQuery(*cfg);" << std::endl
+			<< "  ASSERT(q);" << std::endl
+			<< "  q->init([&] (auto this_thread, auto num_threads) {" << std::endl
+			<< "    return std::vector<IPipeline*>({" << std::endl;
+
+		// list pipelines
+		for (size_t i=0; i<p.pipelines.size(); i++) {
+			if (i > 0) {
+				o << ", ";
+			}
+			o << "      " << new_pipeline << i << "(*q, this_thread)" << std::endl;
+		}
+
+		o << "    });" << std::endl
+			<< "  }, [&] (auto this_thread, auto num_threads) { return new ThisThreadLocal(*q); });" << std::endl;
+
+		// pipeline dependencies
+		o << "  q->set_dependencies({" << std::endl;
+		for (size_t i=0; i<p.pipelines.size(); i++) {
+			auto& pipeline = p.pipelines[i];
+			o << "    {";
+			for (size_t k=0; k<i; k++) {
+				auto& deps = pipeline.dependencies;
+				if (pipeline.dependencies_known &&
+						std::find(deps.begin(), deps.end(), k) == deps.end()) {
+					continue;
+				}
+				o << k << ",";
+			}
+			o << "}," << std::endl;
+		}
+		o << "  });" << std::endl
+			<< "  return q;" << std::endl
+			<< "}"<< std::endl
+			<< "EXPORT void voila_query_run(ThisQuery* q) { ASSERT(q); q->run(0); }"<< std::endl
+			<< "EXPORT void voila_query_reset(ThisQuery* q) { ASSERT(q); q->reset(); }"<< std::endl
+			<< "EXPORT void voila_query_free(ThisQuery* q) { ASSERT(q) delete q; }"<< std::endl;
+
+		// creates pipelines for a query built by another library of the same source (tiering)
+		o << "EXPORT IPipeline* voila_pipeline_new(Query* q, size_t pipeline, size_t thread_id) {" << std::endl
+			<< "  ASSERT(q);" << std::endl
+			<< "  switch (pipeline) {" << std::endl;
+		for (size_t i=0; i<p.pipelines.size(); i++) {
+			o << "  case " << i << ": return " << new_pipeline << i << "(*q, thread_id);" << std::endl;
+		}
+		o << "  default: ASSERT(false); return nullptr;" << std::endl
+			<< "  }" << std::endl
+			<< "}" << std::endl;
+	};
+
+	const std::string s_init(init.str());
+	const std::string s_impl(impl.str());
+	const std::string s_next(next.str());
+
+	// translation units
+	{
+		// everything outside of the pipeline slices
+		auto get_common = [&] (const std::string& s, auto&& get_pos) {
+			std::string r;
+			size_t pos = 0;
+			for (auto& slice : slices) {
+				r += s.substr(pos, get_pos(slice.first) - pos);
+				pos = get_pos(slice.second);
+			}
+			return r + s.substr(pos);
+		};
+
+		auto get_pipeline = [&] (const std::string& s, size_t i, auto&& get_pos) {
+			const size_t begin = get_pos(slices[i].first);
+			return s.substr(begin, get_pos(slices[i].second) - begin);
+		};
+
+		auto pos_init = [] (const Slice& s) { return s.init; };
+		auto pos_impl = [] (const Slice& s) { return s.impl; };
+		auto pos_next = [] (const Slice& s) { return s.next; };
+
+		std::ostringstream main_unit;
+		main_unit << "// init" << std::endl
+			<< get_common(s_init, pos_init) << std::endl
+			<< "// impl" << std::endl
+			<< get_common(s_impl, pos_impl) << std::endl
+			<< "// next" << std::endl
+			<< get_common(s_next, pos_next) << std::endl;
+
+		units.pipelines.clear();
+		for (size_t i=0; i<p.pipelines.size(); i++) {
+			main_unit << "IPipeline* voila_new_pipeline_" << i << "(Query& q, size_t thread_id);" << std::endl;
+
+			std::ostringstream unit;
+			unit << "// init" << std::endl
+				<< get_pipeline(s_init, i, pos_init) << std::endl
+				<< "// impl" << std::endl
+				<< get_pipeline(s_impl, i, pos_impl) << std::endl
+				<< "// next" << std::endl
+				<< get_pipeline(s_next, i, pos_next) << std::endl
+				<< "IPipeline* voila_new_pipeline_" << i << "(Query& q, size_t thread_id) {" << std::endl
+				<< "  return new Pipeline_" << i << "(q, thread_id);" << std::endl
+				<< "}" << std::endl;
+			units.pipelines.emplace_back(unit.str());
+		}
+
+		gen_exports(main_unit, "voila_new_pipeline_");
+		units.main = main_unit.str();
+	}
+
 	out << "// init" << std::endl;
-	out << init.str() << std::endl;
+	out << s_init << std::endl;
 	out << "// impl" << std::endl;
-	out << impl.str() << std::endl;
+	out << s_impl << std::endl;
 	out << "// next" << std::endl;
-	out << next.str() << std::endl;
-	out << "// main" << std::endl;
-
-	out << "EXPORT Query* voila_query_new(QueryConfig* cfg) {" << std::endl
-		<< "  ASSERT(cfg);" << std::endl
-		<< "  ThisQuery* q = new ThisQuery(*cfg);" << std::endl
-		<< "  ASSERT(q);" << std::endl
-		<< "  q->init([&] (auto this_thread, auto num_threads) {" << std::endl
-		<< "    return std::vector<IPipeline*>({" << std::endl;
-
-	// list pipelines
-	for (size_t i=0; i<p.pipelines.size(); i++) {
-		if (i > 0) {
-			out << ", ";
-		}
-		out << "      new Pipeline_" << i << "(*q, this_thread)" << std::endl;
-	}
+	out << s_next << std::endl;
 
-	out << "    });" << std::endl
-		<< "  }, [&] (auto this_thread, auto num_threads) { return new ThisThreadLocal(*q); });" << std::endl
-		<< "  return q;" << std::endl
-		<< "}"<< std::endl
-		<< "EXPORT void voila_query_run(ThisQuery* q) { ASSERT(q); q->run(0); }"<< std::endl
-		<< "EXPORT void voila_query_reset(ThisQuery* q) { ASSERT(q); q->reset(); }"<< std::endl
-		<< "EXPORT void voila_query_free(ThisQuery* q) { ASSERT(q) delete q; }"<< std::endl;
+	gen_exports(out, "new Pipeline_");
 
 	return out.str();
 }
@@ -514,7 +723,8 @@ Codegen::gen_datastructure(DataStructure& d, Program& p)
 
 		cols.emplace_back(TableColumn {type, c.name, c.source,
 			c.mod == DCol::Modifier::kKey,
-			c.mod == DCol::Modifier::kHash}
+			c.mod == DCol::Modifier::kHash,
+			c.combine}
 		);
 	}
 
@@ -546,4 +756,32 @@ Codegen::gen_get_pos(const std::string& dest, const std::string& name,
 		<< offset_var << ", " << size <<");" << std::endl;
 
 	return s.str();
-}
\ No newline at end of file
+}
+std::string
+Codegen::gen_constant(const Expression& e, const std::string& query)
+{
+	ASSERT(e.is_constant());
+	if (!e.is_param()) {
+		return e.fun;
+	}
+
+	return "((ThisQuery&)(" + query + "))." + gen_param_member(e.param);
+}
+
+std::string
+Codegen::gen_param_member(const std::string& param)
+{
+	// escape characters not allowed in identifiers, keeps names unique
+	std::ostringstream s;
+	s << "param_" << std::hex;
+	for (unsigned char c : param) {
+		if (c == '_') {
+			s << "__";
+		} else if (isalnum(c)) {
+			s << c;
+		} else {
+			s << "_" << (int)c;
+		}
+	}
+	return s.str();
+}
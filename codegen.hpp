@@ -76,6 +76,7 @@ public:
 		std::string source; //!< Only for BaseColumns
 		bool key;
 		bool hash;
+		std::string combine; //!< Only for global aggregates
 	};
 
 protected:
@@ -102,6 +103,10 @@ protected:
 	virtual void gen_pipeline(Pipeline& p, size_t number);
 	virtual void gen_lolepop(Lolepop& l, Pipeline& p);
 	virtual void gen_datastructure(DataStructure& d, Program& p);
+
+	//! Generated pipelines process all rows of a morsel, before they get
+	//! the next one
+	virtual bool finishes_morsel_before_next() const { return true; }
 	
 	bool last_pipeline;
 
@@ -148,8 +153,29 @@ protected:
 
 	Codegen(QueryConfig& config);
 public:
+	//! Generated code split into translation units, filled by operator()
+	struct Units {
+		//! Includes, data structures, ThisQuery and ThisThreadLocal
+		std::string header;
+
+		//! Code shared by all pipelines and the exported functions
+		std::string main;
+
+		//! One unit per pipeline, exports 'voila_new_pipeline_<i>'
+		std::vector<std::string> pipelines;
+	};
+
+	Units units;
 
 	std::string operator()(Program& p);
+
+	//! C++ expression for constant 'e'. Parameters are read from members of
+	//! 'query', resolved once when ThisQuery is constructed
+	static std::string gen_constant(const Expression& e,
+		const std::string& query = "query");
+
+	//! Member of ThisQuery holding the value of query parameter 'param'
+	static std::string gen_param_member(const std::string& param);
 };
 
 #endif
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "cg_hyper.hpp"
 #include "cg_fuji.hpp"
 #include "runtime_framework.hpp"
+#include "runtime_scheduler.hpp"
+#include "runtime_memory.hpp"
 #include "utils.hpp"
 #include "voila.hpp"
 #include <sqlite3.h>
@@ -16,16 +18,40 @@
 struct CompilationError {
 };
 
-void Compiler::call_cxx_compiler(const std::string& ifname,
-		const std::string& ofname, const QueryConfig& config) {
-	std::stringstream rm;
-	rm << "rm -f " << ofname;
+#include <sys/stat.h>
+#include <unistd.h>
+#include <thread>
+#include <unordered_set>
 
-	system(rm.str().c_str());
+static std::string
+get_pch_header()
+{
+	return Build::BinaryDir() + "/pch/runtime_pch.hpp";
+}
 
+/* The precompiled header is built by target runtime_pch using g++. GCC
+ * picks the matching variant (optimized/debug) from the .gch directory and
+ * silently falls back to the plain header otherwise. */
+static bool
+has_pch(const QueryConfig& config)
+{
+	if (config.cxx_compiler.find("clang") != std::string::npos) {
+		return false;
+	}
+
+	struct stat st;
+	const std::string gch(get_pch_header() + ".gch");
+	return !stat(gch.c_str(), &st) && S_ISDIR(st.st_mode);
+}
+
+//! 'tier0' selects the quick unoptimized build used for tiered execution
+static std::string
+get_cxx_flags(const QueryConfig& config, bool tier0 = false)
+{
 	std::stringstream s;
-	s << config.cxx_compiler << " ";
-	if (config.optimized) {
+	if (tier0) {
+		s << " -march=native -O0 ";
+	} else if (config.optimized) {
 		s << " -march=native -O3 ";
 	} else {
 		s << " -march=native -O0 -fsanitize=address ";
@@ -43,7 +69,24 @@ void Compiler::call_cxx_compiler(const std::string& ifname,
 		<< " -I " << Build::SourceDir() << "/db-engine-paradigms/include"
 		<< " -I " << Build::SourceDir() 
 		<< " -I ./"
-		<< " -Wall " // -pedantic 
+		<< " -Wall "; // -pedantic 
+
+	if (config.use_pch && has_pch(config)) {
+		s << " -include " << get_pch_header() << " ";
+	}
+	return s.str();
+}
+
+void Compiler::call_cxx_compiler(const std::string& ifname,
+		const std::string& ofname, const QueryConfig& config, bool tier0) {
+	std::stringstream rm;
+	rm << "rm -f " << ofname;
+
+	system(rm.str().c_str());
+
+	std::stringstream s;
+	s << config.cxx_compiler << " "
+		<< get_cxx_flags(config, tier0)
 		<< ifname 
 		<< " -o "
 		<< ofname;
@@ -54,6 +97,175 @@ void Compiler::call_cxx_compiler(const std::string& ifname,
 	}
 }
 
+void Compiler::call_cxx_compiler_units(const std::vector<std::string>& ifnames,
+		const std::string& ofname, const QueryConfig& config, bool tier0) {
+	std::stringstream rm;
+	rm << "rm -f " << ofname;
+
+	system(rm.str().c_str());
+
+	const std::string flags(get_cxx_flags(config, tier0));
+
+	// compile all units in parallel
+	std::vector<int> results(ifnames.size(), 0);
+	std::vector<std::thread> threads;
+	threads.reserve(ifnames.size());
+
+	for (size_t i=0; i<ifnames.size(); i++) {
+		threads.emplace_back([&, i] () {
+			std::stringstream s;
+			s << config.cxx_compiler << " " << flags << " -c "
+				<< ifnames[i] << " -o " << ifnames[i] << ".o";
+			results[i] = system(s.str().c_str());
+		});
+	}
+
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	for (auto& r : results) {
+		if (r) {
+			ASSERT(!r);
+			throw CompilationError();
+		}
+	}
+
+	// link
+	std::stringstream s;
+	s << config.cxx_compiler << " " << flags;
+	for (auto& f : ifnames) {
+		s << " " << f << ".o";
+	}
+	s << " -o " << ofname;
+
+	int r = system(s.str().c_str());
+	if (r) {
+		ASSERT(!r);
+		throw CompilationError();
+	}
+}
+
+/* Content-addressed cache for compiled queries.
+ * The key covers the generated source, the compiler invocation and the
+ * runtime headers the generated code includes. The full key material is
+ * stored next to the library and compared on lookup, so hash collisions
+ * cannot return a wrong library. */
+struct CompileCache {
+	const std::string dir;
+	std::string material;
+	std::string prefix;
+
+	CompileCache(const std::string& dir, const std::string& source,
+			const QueryConfig& config) : dir(dir) {
+		std::ostringstream m;
+		m << config.cxx_compiler << get_cxx_flags(config) << "\n"
+			<< get_headers_fingerprint() << "\n"
+			<< source;
+		material = m.str();
+
+		std::ostringstream p;
+		p << dir << "/" << std::hex << hash(material, 0xcbf29ce484222325ull)
+			<< hash(material, 0x84222325cbf29ce4ull);
+		prefix = p.str();
+	}
+
+	bool lookup(const std::string& ofname) const {
+		const std::string lib(prefix + ".so");
+		if (!FileUtils::exists(lib)) {
+			return false;
+		}
+		if (FileUtils::read_string_from_file(prefix + ".key") != material) {
+			return false;
+		}
+		return copy_file(lib, ofname);
+	}
+
+	void insert(const std::string& lib_fname, int thread_id) const {
+		mkdir(dir.c_str(), 0755);
+
+		// write to temporary files first, then rename atomically
+		const std::string tmp("." + std::to_string(getpid()) + "_" +
+			std::to_string(thread_id));
+		FileUtils::write_string_to_file(prefix + ".key" + tmp, material);
+		if (!copy_file(lib_fname, prefix + ".so" + tmp)) {
+			return;
+		}
+		rename((prefix + ".key" + tmp).c_str(), (prefix + ".key").c_str());
+		rename((prefix + ".so" + tmp).c_str(), (prefix + ".so").c_str());
+	}
+
+private:
+	static uint64_t hash(const std::string& s, uint64_t seed) {
+		// FNV-1a
+		uint64_t h = seed;
+		for (unsigned char c : s) {
+			h ^= c;
+			h *= 0x100000001b3ull;
+		}
+		return h;
+	}
+
+	static bool copy_file(const std::string& src, const std::string& dst) {
+		std::ifstream in(src, std::ios::binary);
+		std::ofstream out(dst, std::ios::binary | std::ios::trunc);
+		if (!in.good() || !out.good()) {
+			return false;
+		}
+		out << in.rdbuf();
+		return out.good();
+	}
+
+	static std::string resolve_header(const std::string& name) {
+		// Runtime headers live in the source directory, generated kernels
+		// next to the binary
+		const std::string src(Build::SourceDir() + "/" + name);
+		if (FileUtils::exists(src)) {
+			return src;
+		}
+		return "./" + name;
+	}
+
+	/* Hashes the #include "..." closure of runtime_pch.hpp, which mirrors
+	 * the includes of generated code. Deriving the list ensures that newly
+	 * included runtime headers invalidate cached libraries as well. */
+	static const std::string& get_headers_fingerprint() {
+		static const std::string fingerprint = [] () {
+			std::ostringstream s;
+			std::unordered_set<std::string> seen;
+			std::vector<std::string> todo = { "runtime_pch.hpp" };
+
+			while (!todo.empty()) {
+				const std::string h(todo.back());
+				todo.pop_back();
+				if (!seen.insert(h).second) {
+					continue;
+				}
+
+				const std::string content(
+					FileUtils::read_string_from_file(resolve_header(h)));
+				s << h << ":" << std::hex << hash(content, 0) << ";";
+
+				std::istringstream lines(content);
+				std::string line;
+				while (std::getline(lines, line)) {
+					const auto pos = line.find_first_not_of(" \t");
+					if (pos == std::string::npos || line.compare(pos, 10, "#include \"")) {
+						continue;
+					}
+					const auto begin = pos + 10;
+					const auto end = line.find('"', begin);
+					if (end != std::string::npos) {
+						todo.push_back(line.substr(begin, end - begin));
+					}
+				}
+			}
+			return s.str();
+		}();
+		return fingerprint;
+	}
+};
+
 #include "runtime.hpp"
 #include <chrono>
 #include <dlfcn.h>
@@ -82,6 +294,48 @@ typedef void (*voila_query_run_t)(Query*);
 typedef void (*voila_query_reset_t)(Query*);
 typedef void (*voila_query_free_t)(Query*);
 
+void
+Compiler::compile_library(const std::string& ofname, const QueryConfig& config,
+	bool tier0)
+{
+	if (unit_fnames.empty()) {
+		call_cxx_compiler(tmp_fname, ofname, config, tier0);
+	} else {
+		call_cxx_compiler_units(unit_fnames, ofname, config, tier0);
+	}
+}
+
+//! Include of the header shared by all units
+static std::string
+get_header_include(const std::string& hdr_fname)
+{
+	return "#include \"" + hdr_fname.substr(hdr_fname.rfind('/') + 1) + "\"\n";
+}
+
+std::string
+Compiler::read_source() const
+{
+	if (unit_fnames.empty()) {
+		return FileUtils::read_string_from_file(tmp_fname);
+	}
+
+	// file names differ per Compiler, the cache key must not depend on them
+	const std::string include(get_header_include(hdr_fname));
+
+	std::ostringstream s;
+	s << "// header" << std::endl
+		<< FileUtils::read_string_from_file(hdr_fname) << std::endl;
+	for (size_t i=0; i<unit_fnames.size(); i++) {
+		std::string unit(FileUtils::read_string_from_file(unit_fnames[i]));
+		if (!unit.compare(0, include.size(), include)) {
+			unit = unit.substr(include.size());
+		}
+		s << "// unit " << i << std::endl
+			<< unit << std::endl;
+	}
+	return s.str();
+}
+
 #include "relalg_translator.hpp"
 #include "printing_pass.hpp"
 #include "PerfEvent.hpp"
@@ -108,10 +362,17 @@ struct SqliteDB {
 			"LLCmisses REAL NULL, branchmisses REAL NULL, taskclock REAL NULL, threads INTEGER, "
 			"cgen_ms REAL NULL, ccomp_ms REAL NULL, default_blend TEXT, key_check_blend TEXT, "
 			"aggregates_blend TEXT, backend TEXT, scale_factor INTEGER, pipeline_flavor TEXT, "
-			"full_blend TEXT);");
+			"full_blend TEXT, dTLBmisses REAL NULL, hugepages_mb REAL NULL);");
 		char* err_msg;
 		int rc = sqlite3_exec(db, sql.c_str(), 0, 0, &err_msg);
 		sqlite3_free(err_msg);
+
+		// databases created before these columns existed
+		for (auto col : {"dTLBmisses", "hugepages_mb"}) {
+			sql = "ALTER TABLE runs ADD COLUMN " + std::string(col) + " REAL NULL;";
+			rc = sqlite3_exec(db, sql.c_str(), 0, 0, &err_msg);
+			sqlite3_free(err_msg);
+		}
 	}
 
 	~SqliteDB() {
@@ -129,9 +390,9 @@ static void record_run(SqliteDB& sqlite_db, const QueryConfig& config, PerfEvent
 	sqlite3_prepare_v2(sqlite_db.db, "INSERT INTO runs(t, mode, query, result, " // 1 - 3
 			"rep, time_ms, tuples, cycles, instructions, L1misses, LLCmisses, branchmisses, taskclock, " // 4 - 11
 			"threads, cgen_ms, ccomp_ms, default_blend, key_check_blend, aggregates_blend, backend, " // 12 -
-			"scale_factor, pipeline_flavor, full_blend)"
+			"scale_factor, pipeline_flavor, full_blend, dTLBmisses, hugepages_mb)"
 		"VALUES (datetime('now','localtime'), ?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, "
-			"?10, ?11, ?12, ?13, ?14, ?15, ?16, ?17, ?18, ?19, ?20, ?21, ?22);", -1, &stmt, NULL);
+			"?10, ?11, ?12, ?13, ?14, ?15, ?16, ?17, ?18, ?19, ?20, ?21, ?22, ?23, ?24);", -1, &stmt, NULL);
 
 	int index = 0;
 
@@ -244,7 +505,18 @@ static void record_run(SqliteDB& sqlite_db, const QueryConfig& config, PerfEvent
 		}
 	}
 
-	ASSERT(index == 22);
+	index++;
+	if (events && events->hasCounter("dTLB-misses")) {
+		sqlite3_bind_double(stmt, index, events->getCounter("dTLB-misses"));
+	} else {
+		sqlite3_bind_null(stmt, index);
+	}
+
+	index++;
+	sqlite3_bind_double(stmt, index,
+		(double)HugePages::get_mapped_bytes() / (1024.0 * 1024.0));
+
+	ASSERT(index == 24);
 	int rc = sqlite3_step(stmt);
 	if (rc != SQLITE_DONE) {
 		std::cerr << "ERROR inserting data: " << sqlite3_errmsg(sqlite_db.db) << std::endl;
@@ -299,12 +571,16 @@ Compiler::run(QueryConfig& config, BenchmarkQuery& bq)
 	SafeEnv::Result status = SafeEnv::Result::Success;
 
 	status = safe([&] () {
-		std::cerr << "Loading " << exe_fname << std::endl;
-		void* library = dlopen(exe_fname.c_str(), RTLD_NOW);
+		// compile() only built the first tier
+		const bool tiered = FileUtils::exists(tier0_fname);
+		const std::string& lib_fname = tiered ? tier0_fname : exe_fname;
+
+		std::cerr << "Loading " << lib_fname << std::endl;
+		void* library = dlopen(lib_fname.c_str(), RTLD_NOW);
 
-		_run(config, bq, library);
+		_run(config, bq, library, tiered);
 
-		std::cerr << "Closing " << exe_fname << std::endl;
+		std::cerr << "Closing " << lib_fname << std::endl;
 		dlclose(library);
 	});
 
@@ -352,18 +628,22 @@ double Compiler::_generate(QueryConfig& config, BenchmarkQuery& bq,
 		transl(*bq.root);
 		bq.prog = &transl.prog;
 
+		Codegen::Units units;
+
 		Program& p = *bq.prog;
 		switch (config.flavor) {
 		case QueryConfig::Flavor::Hyper:
 			{
 				HyperCodegen hg(config);
 				s << hg(p);	
+				units = hg.units;
 			}
 			break;
 		case QueryConfig::Flavor::Vectorwise:
 			{
 				VectorCodegen vg(config);
 				s << vg(p);
+				units = vg.units;
 			}
 			break;
 
@@ -371,6 +651,7 @@ double Compiler::_generate(QueryConfig& config, BenchmarkQuery& bq,
 			{
 				FujiCodegen fg(config);
 				s << fg(p);
+				units = fg.units;
 			}
 			break;
 		default:
@@ -379,8 +660,33 @@ double Compiler::_generate(QueryConfig& config, BenchmarkQuery& bq,
 		}
 
 		s << std::endl;
-		// write source code
-		FileUtils::write_string_to_file(tmp_fname, s.str());
+
+		unit_fnames.clear();
+		if (!config.parallel_compile || units.pipelines.size() < 2) {
+			// write source code
+			FileUtils::write_string_to_file(tmp_fname, s.str());
+			return;
+		}
+
+		// one unit per pipeline, sharing a common header
+		const std::string include(get_header_include(hdr_fname));
+
+		std::vector<std::pair<std::string, std::string>> files = {
+			{ hdr_fname, units.header },
+			{ tmp_fname, include + units.main }
+		};
+		unit_fnames.push_back(tmp_fname);
+
+		const std::string prefix(tmp_fname.substr(0, tmp_fname.size() - 4));
+		for (size_t i=0; i<units.pipelines.size(); i++) {
+			const std::string fname(prefix + "_p" + std::to_string(i) + ".cpp");
+			files.push_back({ fname, include + units.pipelines[i] });
+			unit_fnames.push_back(fname);
+		}
+
+		for (auto& f : files) {
+			FileUtils::write_string_to_file(f.first, f.second);
+		}
 	});
 }
 
@@ -457,12 +763,38 @@ Compiler::_compile(QueryConfig& config, BenchmarkQuery& bq)
 
 	std::cerr << "Compiling" << std::endl;
 	t_ccomp_ms = measure_ms([&] () {
-		call_cxx_compiler(tmp_fname, exe_fname, config);
+		unlink(tier0_fname.c_str());
+
+		const bool use_cache = !config.compile_cache_dir.empty();
+		CompileCache cache(config.compile_cache_dir, read_source(), config);
+
+		if (use_cache && cache.lookup(exe_fname)) {
+			std::cerr << "Found in cache " << cache.prefix << std::endl;
+			return;
+		}
+
+		if (config.tiered && config.optimized) {
+			// only build the first tier, run() compiles the optimized library
+			compile_library(tier0_fname, config, true);
+
+			std::ostringstream units;
+			for (auto& f : unit_fnames) {
+				units << f << std::endl;
+			}
+			FileUtils::write_string_to_file(tier0_fname + ".units", units.str());
+			return;
+		}
+
+		compile_library(exe_fname, config, false);
+		if (use_cache) {
+			cache.insert(exe_fname, thread_id);
+		}
 	});
 }
 
 void
-Compiler::_run(QueryConfig& config, BenchmarkQuery& bq, void* library)
+Compiler::_run(QueryConfig& config, BenchmarkQuery& bq, void* library,
+	bool tiered)
 {
 	std::cerr << "Waiting until machine is clear" << std::endl;
 
@@ -496,10 +828,61 @@ Compiler::_run(QueryConfig& config, BenchmarkQuery& bq, void* library)
     query = qnew(&config);
     ASSERT(query);
 
+	// compile the optimized library in the background and switch over,
+	// once it is available
+	void* opt_library = nullptr;
+	std::thread tier_up;
+	bool tiered_up = false;
+	if (tiered) {
+		// compile() may have run in this Compiler already and listed the units
+		unit_fnames.clear();
+		for (auto& f : split(FileUtils::read_string_from_file(tier0_fname + ".units"), '\n')) {
+			if (!f.empty()) {
+				unit_fnames.push_back(f);
+			}
+		}
+
+		tier_up = std::thread([&] () {
+			try {
+				compile_library(exe_fname, config, false);
+			} catch (const CompilationError&) {
+				std::cerr << "Cannot compile optimized tier" << std::endl;
+				return;
+			}
+
+			if (!config.compile_cache_dir.empty()) {
+				CompileCache(config.compile_cache_dir, read_source(), config)
+					.insert(exe_fname, thread_id);
+			}
+
+			opt_library = dlopen(exe_fname.c_str(), RTLD_NOW);
+			if (!opt_library) {
+				std::cerr << dlerror() << std::endl;
+				return;
+			}
+
+			voila_pipeline_new_t pnew;
+			*(void **) (&pnew) = dlsym(opt_library, "voila_pipeline_new");
+			if (!pnew) {
+				std::cerr << dlerror() << std::endl;
+				return;
+			}
+
+			std::cerr << "Optimized tier ready" << std::endl;
+			query->tier_up(pnew);
+			tiered_up = true;
+		});
+	}
+
+	auto& qresult = query->result;
 	if (config.compare_result_to_file.size() > 0 && config.check_result) {
-		query->result.expected = FileUtils::read_string_from_file(config.compare_result_to_file);
+		qresult.expected_file = config.compare_result_to_file;
+		qresult.has_expected_fingerprint = ResultFingerprint::from_file(
+			qresult.expected_fingerprint, qresult.expected_file);
 	} else {
-    	query->result.expected = bq.result;
+		qresult.expected_file = bq.result_file;
+		qresult.has_expected_fingerprint = !bq.result_fingerprint.empty() &&
+			ResultFingerprint::from_string(qresult.expected_fingerprint, bq.result_fingerprint);
 	}
 
 	std::cerr << "Running query" << std::endl;
@@ -534,6 +917,17 @@ Compiler::_run(QueryConfig& config, BenchmarkQuery& bq, void* library)
 
 			std::cerr << "Ran in " << time/std::chrono::milliseconds(1) << " ms" << std::endl;
 
+			if (config.scheduler) {
+				auto stats = config.scheduler->get_stats(*query);
+				std::cerr << "Query '" << config.query_name << "': latency "
+					<< stats.latency_ms << " ms, throughput "
+					<< stats.get_throughput() << " tuples/s" << std::endl;
+			}
+
+			if (r+1 == config.num_hot_reps) {
+				query->memory.print(std::cerr);
+			}
+
 			t_ms = time/std::chrono::milliseconds(1);
 			p_sum_time += t_ms;
 			if (!r) {
@@ -562,7 +956,8 @@ Compiler::_run(QueryConfig& config, BenchmarkQuery& bq, void* library)
 			record_run(sqlite_db, config, &pevts, result, t_ms, r,
 				true, t_cgen_ms, t_ccomp_ms);
 		} catch (const std::bad_alloc& ex) {
-			result = "OOM '" + std::string(ex.what()) + "'";		
+			result = "OOM '" + std::string(ex.what()) + "'";
+			query->memory.print(std::cerr);
 			record_run(sqlite_db, config, &pevts, result, t_ms, r,
 				true, t_cgen_ms, t_ccomp_ms);
 		} catch (const std::exception& ex) {
@@ -587,6 +982,19 @@ Compiler::_run(QueryConfig& config, BenchmarkQuery& bq, void* library)
 		f.close();
 	}
 
+	if (tier_up.joinable()) {
+		tier_up.join();
+	}
+	if (tiered && !tiered_up) {
+		// otherwise the query silently stays on the unoptimized build
+		std::cerr << "Optimized tier failed" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
 	std::cerr << "Freeing query" << std::endl;
 	qfree(query);
+
+	if (opt_library) {
+		dlclose(opt_library);
+	}
 }
\ No newline at end of file
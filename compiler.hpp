@@ -16,14 +16,26 @@ struct QueryConfig;
 struct Compiler {
 private:
 	static void call_cxx_compiler(const std::string& ifname,
-		const std::string& ofname, const QueryConfig& c);
+		const std::string& ofname, const QueryConfig& c, bool tier0);
+	static void call_cxx_compiler_units(const std::vector<std::string>& ifnames,
+		const std::string& ofname, const QueryConfig& c, bool tier0);
+
+	void compile_library(const std::string& ofname, const QueryConfig& c,
+		bool tier0);
+	std::string read_source() const;
 
 public:
 	const std::string share_fname;
 	const std::string tmp_fname;
 	const std::string exe_fname;
+	const std::string hdr_fname;
+	//! Unoptimized library used for tiered execution
+	const std::string tier0_fname;
 	const int thread_id;
 
+	//! Translation units, if the query was split for parallel compilation
+	std::vector<std::string> unit_fnames;
+
 	double t_cgen_ms = 0.0;
 	double t_ccomp_ms = 0.0;	
 
@@ -31,13 +43,15 @@ public:
 	 : share_fname("voila_compiler_" + postfix + "")
 	 , tmp_fname("/tmp/voila" + postfix + ".cpp")
 	 , exe_fname("/tmp/run" + postfix + "")
+	 , hdr_fname("/tmp/voila" + postfix + ".hpp")
+	 , tier0_fname("/tmp/run" + postfix + "_tier0")
 	 , thread_id(thread_id)
 	{}
 
 private:
 	void _compile(QueryConfig& config, BenchmarkQuery& p);
 	void _run(QueryConfig& config, BenchmarkQuery& p,
-		void* library);
+		void* library, bool tiered);
 
 public:
 	std::string compile(QueryConfig& config, BenchmarkQuery& p);
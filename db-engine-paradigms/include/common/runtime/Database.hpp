@@ -12,7 +12,7 @@
 #include <vector>
 #include <limits>
 
-#ifndef IS_DEBUG
+#if !defined(IS_DEBUG) && !defined(IS_RELEASE)
 #define IS_RELEASE // fix compile-time error
 #endif
 
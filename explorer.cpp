@@ -9,6 +9,7 @@
 #include "utils.hpp"
 #include "libs/cxxopts.hpp"
 #include "bench_tpch.hpp"
+#include "relalg.hpp"
 #include "explorer_helper.hpp"
 #include "build.hpp"
 #include "compiler.hpp"
@@ -133,6 +134,46 @@ backtrack_per_pipeline(QueryConfig& qconf, BenchmarkQuery& query, size_t depth,
 	}
 }
 
+static size_t
+count_hash_joins(const relalg::RelOp* op)
+{
+	if (!op) {
+		return 0;
+	}
+	return (dynamic_cast<const relalg::HashJoin*>(op) ? 1 : 0) +
+		count_hash_joins(op->left.get()) + count_hash_joins(op->right.get());
+}
+
+void
+backtrack_hash_layout(QueryConfig& qconf, BenchmarkQuery& query, size_t join,
+	size_t num_joins)
+{
+	if (join == num_joins) {
+		std::string layout;
+		for (size_t j=0; j<num_joins; j++) {
+			if (qconf.radix_joins.count(j)) {
+				layout += "radix ";
+			} else {
+				layout += qconf.open_addressing_joins.count(j) ? "open " : "chained ";
+			}
+		}
+		printf("RUN: hash layout = %s\n", layout.c_str());
+		compile(qconf, query, 1, "1");
+		return;
+	}
+
+	qconf.open_addressing_joins.erase(join);
+	backtrack_hash_layout(qconf, query, join+1, num_joins);
+
+	qconf.open_addressing_joins.insert(join);
+	backtrack_hash_layout(qconf, query, join+1, num_joins);
+	qconf.open_addressing_joins.erase(join);
+
+	qconf.radix_joins.insert(join);
+	backtrack_hash_layout(qconf, query, join+1, num_joins);
+	qconf.radix_joins.erase(join);
+}
+
 static size_t g_explore_invalid = 0;
 
 
@@ -537,10 +578,12 @@ int main(int argc, char* argv[]) {
 		("seed", "Random seed used for sampling", cxxopts::value<int>()->default_value(std::to_string(random_seed())))
 		("q,query", "Query to run", cxxopts::value<std::string>()->default_value("q9"))
 		("compiler", "C++ compiler to use", cxxopts::value<std::string>()->default_value("g++"))
+		("compile_cache", "Directory for caching compiled queries, empty disables caching", cxxopts::value<std::string>()->default_value(Build::BinaryDir() + "/compile_cache"))
 		("unsafe", "Do not use safe mode")
 		("no-check", "Do not check query results")
 		("base", "Explore only base flavors")
 		("pipeline", "Explore base flavors for expensive pipelines")
+		("hash_layout", "Explore chained, open addressing or radix-partitioned layout per hash join")
 		("full", "Full exploration. With level. 0: limited, no-pipeline flavors; 1: limited, per-pipeline "
 			"2: unlimited, no-pipeline, 3: unlimited, per-pipeline, 4: like 3 but also including uninteresting pipeline",
 			cxxopts::value<int>()->default_value("1"))
@@ -597,6 +640,7 @@ int main(int argc, char* argv[]) {
 		qconf.num_hot_reps= cmd["hot_runs"].as<int>();
 		qconf.scale_factor= scale_factor;
 		qconf.cxx_compiler = cmd["compiler"].as<std::string>();
+		qconf.compile_cache_dir = cmd["compile_cache"].as<std::string>();
 
 		fd_lock = open(cmd["lock_file"].as<std::string>().c_str(), O_CREAT);
 		FdLockGuard lock_guard(fd_lock);
@@ -625,6 +669,14 @@ int main(int argc, char* argv[]) {
 			g_explore_mode = ExploreMode::ExploreAll;
 		}
 
+		if (cmd.count("hash_layout") > 0) {
+			if (g_explore_mode != ExploreMode::Unknown) {
+				std::cerr << "Can only set one mode" << std::endl;
+				exit(1);
+			}
+			g_explore_mode = ExploreMode::HashLayout;
+		}
+
 		g_explore_sample_num = cmd["sample"].as<int64_t>() <= 0 ? 0 : cmd["sample"].as<int64_t>();
 
 		switch (g_explore_mode) {
@@ -637,6 +689,9 @@ int main(int argc, char* argv[]) {
 		case ExploreMode::ExploreAll:
 			printf("MODE: full explore\n");
 			break;
+		case ExploreMode::HashLayout:
+			printf("MODE: explore hash table layouts\n");
+			break;
 		case ExploreMode::Unknown:
 			std::cerr << "Unknown mode" << std::endl;
 			exit(1);
@@ -721,6 +776,15 @@ int main(int argc, char* argv[]) {
 			}
 			break;
 
+		case ExploreMode::HashLayout:
+			{
+				const size_t num_joins = count_hash_joins(bench_query.root.get());
+				printf("RUN: %d hash joins\n", (int)num_joins);
+
+				backtrack_hash_layout(qconf, bench_query, 0, num_joins);
+			}
+			break;
+
 		default:
 			std::cerr << "Unsupported mode" << std::endl;
 			exit(1);
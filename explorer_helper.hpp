@@ -11,7 +11,8 @@ enum ExploreMode {
 	Unknown = 0,
 	OnlyBase,
 	PerPipelineBase,
-	ExploreAll
+	ExploreAll,
+	HashLayout
 };
 extern ExploreMode g_explore_mode;
 extern bool g_explore_dry;
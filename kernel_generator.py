@@ -256,12 +256,23 @@ def wrap(ctx, result, types):
 				void* bucket = *((void**)col3[0]);
 				auto data_ptr = (decltype(res) RESTRICT)((char* RESTRICT)bucket + offset);
 				auto data = *data_ptr;
-				IHashTable* RESTRICT table = (IHashTable*)col4[0]; 
-				auto hash_ptr = (u64*)((char* RESTRICT)bucket + table->hash_offset);
-				*hash_ptr = kGlobalAggrHashVal;
 				""",
 				epilogue="*data_ptr = data;")
 
+			# the row starts at the neutral element, see ITable::init_global_row()
+			for (name, op) in [("aggr_gmin", "<"), ("aggr_gmax", ">")]:
+				if types[0] != result:
+					break
+				gen_primitive(ctx, name, result, types,
+					"if (col2[i] " + op + " data) {{ data = col2[i]; }}",
+					prologue="""
+					size_t offset = ((ITable::ColDef*)(col1[0]))->offset;
+					void* bucket = *((void**)col3[0]);
+					auto data_ptr = (decltype(res) RESTRICT)((char* RESTRICT)bucket + offset);
+					auto data = *data_ptr;
+					""",
+					epilogue="*data_ptr = data;")
+
 	if not is_one_type(types[3]):
 		return
 
@@ -278,9 +289,6 @@ def wrap(ctx, result, types):
 				void* bucket = *((void**)col2[0]);
 				auto data_ptr = (decltype(res) RESTRICT)((char* RESTRICT)bucket + offset);
 				auto data = *data_ptr;
-				IHashTable* RESTRICT table = (IHashTable*)col3[0]; 
-				auto hash_ptr = (u64*)((char* RESTRICT)bucket + table->hash_offset);
-				*hash_ptr = kGlobalAggrHashVal;
 				*data_ptr = data + inum;
 				return inum;
 				""",
@@ -298,7 +306,8 @@ def wrap(ctx, result, types):
 				// printf("%s: data=%lld\\n", __func__, (i64)*data);
 
 				*data = *data + col3[i];""",
-				prologue="""size_t offset = ((ITable::ColDef*)(col1[0]))->offset;""")
+				prologue="""size_t offset = ((ITable::ColDef*)(col1[0]))->offset;
+				if (((ITable::ColDef*)(col1[0]))->atomic) return shared_aggr_sum(sel, inum, res, col2, col3, offset);""")
 			gen_primitive(ctx, "aggr_count", result, types,
 				"""
 				/* std::cout << inum << "count @" << (i64)col2[i] << std::endl; */
@@ -309,13 +318,21 @@ def wrap(ctx, result, types):
 
 				// printf("%s: data=%lld\\n", __func__, (i64)*data);
 				*data = *data + 1; (void)col3;""",
-				prologue="""size_t offset = ((ITable::ColDef*)(col1[0]))->offset;""")
+				prologue="""size_t offset = ((ITable::ColDef*)(col1[0]))->offset;
+				if (((ITable::ColDef*)(col1[0]))->atomic) return shared_aggr_count(sel, inum, res, col2, offset);""")
 
-			if False and types[0] == result:
-				gen_primitive(ctx, "aggr_min", result, types,
-					"if (col1[i] < res[col2[i] * col1[0]]) {{ res[col2[i] * col1[0]] = col3[i]; }};")
-				gen_primitive(ctx, "aggr_max", result, types,
-					"if (col1[i] > res[col2[i] * col1[0]]) {{ res[col2[i] * col1[0]] = col3[i]; }};")
+			# new groups are initialized with their first value
+			for (name, op, is_min) in [("aggr_min", "<", "true"), ("aggr_max", ">", "false")]:
+				if not is_index(types[1]):
+					break
+				gen_primitive(ctx, name, result, types,
+					"""
+					DBG_ASSERT(col2[i] != 0);
+
+					auto data = (decltype(res) RESTRICT)((char* RESTRICT)col2[i] + offset);
+					if (col3[i] """ + op + """ *data) {{ *data = col3[i]; }}""",
+					prologue="""size_t offset = ((ITable::ColDef*)(col1[0]))->offset;
+					if (((ITable::ColDef*)(col1[0]))->atomic) return shared_aggr_minmax<""" + is_min + """>(sel, inum, res, col2, col3, offset);""")
 
 		if is_index(types[2]) and is_cardinal(types[1]):
 			if types[0] == result:
@@ -444,6 +461,11 @@ decltype(res) data = (decltype(res) RESTRICT)((char* RESTRICT)res + offset);
 					gen_primitive(ctx, name, result, types,
 						"""res[i] = ({res_t})col1[i] """ + op + """ ({res_t})col2[i];""", allow_full_eval=True)
 
+				# late division of AVG, rounded, an empty group yields 0
+				if result == types[0]:
+					gen_primitive(ctx, "div", result, types,
+						"""res[i] = voila_div(col1[i], col2[i]);""", allow_full_eval=True)
+
 
 			ops = [("lt", "<"), ("le", "<="), ("gt", ">"), ("ge", ">="),
 				("and", "&&"), ("or", "||")]
@@ -475,14 +497,15 @@ decltype(res) data = (decltype(res) RESTRICT)((char* RESTRICT)res + offset);
 		auto& head = heads[idx];
 		res[i] = 0;
 
-		bool conflict = head >= ptr_begin && head <= ptr_end;
+		const u64 first = BucketTag::ptr(head);
+		bool conflict = first >= ptr_begin && first <= ptr_end;
 
 		if (!conflict) {{
 
 			res[i] = (u64)((char*)ptr_begin + (row_width*num_inserted));
-			nexts[num_inserted * next_stride] = head;
+			nexts[num_inserted * next_stride] = first;
 
-			head = res[i];
+			head = BucketTag::head(head, res[i], indices[i]);
 			num_inserted++;
 		}}
 
@@ -490,6 +513,8 @@ decltype(res) data = (decltype(res) RESTRICT)((char* RESTRICT)res + offset);
 					prologue="""
 		if (!inum) return 0;
 		IHashTable* RESTRICT table = (IHashTable*)col1[0]; 
+		if (table->is_open_addressing()) return open_bucket_insert(sel, inum, res, table, col2);
+		if (table->is_shared()) return shared_bucket_insert(sel, inum, res, table, col2);
 
 		/* prealloc space for potential new groups */
 		Block* block = table->hash_append_prealloc<false>(inum);
@@ -524,12 +549,13 @@ decltype(res) data = (decltype(res) RESTRICT)((char* RESTRICT)res + offset);
 
 			gen_primitive(ctx, "bucket_lookup", result, types,
 				"""
-				res[i] = buckets[col2[i] & mask];
+				res[i] = BucketTag::lookup(buckets[col2[i] & mask], col2[i]);
 				/*
 				LOG_DEBUG("%s: i=%lld idx=%lld res=%p\\n", __func__, i, col2[i], res[i]);
 				*/
 				""",
 				prologue="""IHashTable* RESTRICT table = (IHashTable*)col1[0];
+				if (table->is_open_addressing()) return open_bucket_lookup(sel, inum, res, table, col2);
 				const u64 RESTRICT * buckets = (u64*)table->get_hash_index();
 				const u64 mask = table->get_hash_index_mask();
 
@@ -547,12 +573,16 @@ decltype(res) data = (decltype(res) RESTRICT)((char* RESTRICT)res + offset);
 				res[i] = *data;
 				""",
 				prologue="""IHashTable* RESTRICT table = (IHashTable*)col1[0];
+				if (table->is_open_addressing()) return open_bucket_next(sel, inum, res, table, col2);
 				const size_t next_offset = table->next_offset;
 #ifdef __AVX512F__
 	if (sizeof(col2[0]) == 8) return avx512_bucket_next(sel, inum, res, (u64*)col2, next_offset);
 #endif
 
 				""")
+			gen_primitive(ctx, "bucket_link", result, types,
+				"res[i] = table->shared_link((char*)col2[i]) ? col2[i] : 0;",
+				prologue="IHashTable* RESTRICT table = (IHashTable*)col1[0];")
 		if types[0] == "u64" and types[1] == "u64":
 			gen_primitive(ctx, "bucket_build", result, types,
 					"break; (void)res; (void)col1; (void)i;",
@@ -600,6 +630,10 @@ decltype(res) data = (decltype(res) RESTRICT)((char* RESTRICT)res + offset);
 			gen_primitive(ctx, "aggr_direct_gcount", result, types,
 				"""(void)i; (void)col1;""",
 				prologue="""res[0] += inum; LOG_TRACE("%s: res=%d inum=%d\\n", __func__, res[0], inum);return inum;""")
+			gen_primitive(ctx, "aggr_direct_gmin", result, types,
+				"if (col1[i] < res[0]) {{ res[0] = col1[i]; }}")
+			gen_primitive(ctx, "aggr_direct_gmax", result, types,
+				"if (col1[i] > res[0]) {{ res[0] = col1[i]; }}")
 			gen_primitive(ctx, "aggr_direct_gconst1", result, types,
 				"""res[0] = 1; (void)i; (void)col1;""")
 
@@ -8,6 +8,8 @@
 #include "utils.hpp"
 #include "compiler.hpp"
 #include "runtime_framework.hpp"
+#include "runtime_scheduler.hpp"
+#include "runtime_memory.hpp"
 #include "libs/cxxopts.hpp"
 #include "bench_tpch.hpp"
 
@@ -32,9 +34,32 @@ int main(int argc, char* argv[]) {
 		("no-run", "Only compile, do not run query")
 		("no-result", "Do not print results")
 		("no-check", "Do not check query results")
+		("no-fingerprint", "Check results by comparing all rows, instead of fingerprints")
 		("s,scale_factor", "TPC-H scale factor", cxxopts::value<int>()->default_value("1"))
 		("q,queries", "Queries to run, separated by ','", cxxopts::value<std::string>()->default_value("j1"))
 		("compiler", "C++ compiler to use", cxxopts::value<std::string>()->default_value("g++"))
+		("compile_cache", "Directory for caching compiled queries, empty disables caching", cxxopts::value<std::string>()->default_value(Build::BinaryDir() + "/compile_cache"))
+		("no-pch", "Do not use precompiled runtime headers")
+		("no-parallel-compile", "Compile query as one translation unit")
+		("tiered", "Start on an unoptimized build, switch to the optimized build once compiled")
+		("no-concurrent-pipelines", "Run pipelines strictly one after another")
+		("no-numa", "Ignore NUMA topology for data placement and scans")
+		("huge_pages", "Huge pages for hash indices and large blocks: none, thp or explicit", cxxopts::value<std::string>()->default_value("thp"))
+		("memory_limit_mb", "Memory limit per query, 0 disables the limit", cxxopts::value<int>()->default_value("0"))
+		("spill_limit_mb", "Spill aggregation partitions to disk above this memory usage per query, must be below --memory_limit_mb. Hash joins are not spilled. 0 disables spilling", cxxopts::value<int>()->default_value("0"))
+		("spill_dir", "Directory for spill files", cxxopts::value<std::string>()->default_value("/tmp"))
+		("memory_pool_mb", "Maximum memory cached for reuse across runs", cxxopts::value<int>()->default_value("4096"))
+		("open_addressing", "Hash tables with open addressing: 'all' or hash joins by number, separated by ','", cxxopts::value<std::string>()->default_value(""))
+		("radix_joins", "Radix-partitioned hash joins by number, separated by ','", cxxopts::value<std::string>()->default_value(""))
+		("radix_join_min_build_rows", "Radix-partition hash joins from this many estimated build rows on, 0 disables", cxxopts::value<int>()->default_value("0"))
+		("radix_join_partition_kb", "Target size of a radix join partition", cxxopts::value<int>()->default_value("1024"))
+		("incremental_index_growth", "Grow thread-local hash indices by splitting buckets over later inserts, instead of rebuilding")
+		("partitions_per_thread", "Flush partitions per thread for two-phase aggregation", cxxopts::value<int>()->default_value("4"))
+		("shared_aggr_min_groups", "Aggregate into one shared hash table from this many estimated groups on, 0 disables", cxxopts::value<int>()->default_value("0"))
+		("concurrent_queries", "Run all queries at the same time, sharing the threads. Not with --safe")
+		("query_threads", "With --concurrent_queries, maximum #threads per query, 0 uses all", cxxopts::value<int>()->default_value("0"))
+		("priority", "With --concurrent_queries, priority per query (0 low, 1 normal, 2 high), separated by ','", cxxopts::value<std::string>()->default_value(""))
+		("param", "Bind query parameter, as name=value, separated by ','", cxxopts::value<std::string>()->default_value(""))
 		("result", "Write result to file", cxxopts::value<std::string>()->default_value(""))
 		("profile", "Write profile to file", cxxopts::value<std::string>()->default_value(""))
 		("compare", "Compare result to file", cxxopts::value<std::string>()->default_value(""))
@@ -63,10 +88,51 @@ int main(int argc, char* argv[]) {
 
 		qconf.vector_size = cmd["vector_size"].as<int>();
 		qconf.morsel_size = cmd["morsel_size"].as<int>();
+		qconf.partitions_per_thread = cmd["partitions_per_thread"].as<int>();
+		qconf.shared_aggr_min_groups = cmd["shared_aggr_min_groups"].as<int>();
+		for (auto& join : split(cmd["open_addressing"].as<std::string>(), ',')) {
+			if (!join.compare("all")) {
+				qconf.open_addressing = true;
+			} else {
+				qconf.open_addressing_joins.insert(std::stoi(join));
+			}
+		}
+		for (auto& join : split(cmd["radix_joins"].as<std::string>(), ',')) {
+			qconf.radix_joins.insert(std::stoi(join));
+		}
+		qconf.radix_join_min_build_rows = cmd["radix_join_min_build_rows"].as<int>();
+		qconf.radix_join_partition_bytes = (size_t)cmd["radix_join_partition_kb"].as<int>() * 1024;
+		qconf.incremental_index_growth = cmd.count("incremental_index_growth");
+		{
+			// process-wide, i.e. shared by all queries
+			const auto huge = cmd["huge_pages"].as<std::string>();
+			HugePages::Policy policy;
+			if (!huge.compare("none")) {
+				policy = HugePages::Policy::None;
+			} else if (!huge.compare("thp")) {
+				policy = HugePages::Policy::Transparent;
+			} else if (!huge.compare("explicit")) {
+				policy = HugePages::Policy::Explicit;
+			} else {
+				std::cerr << "Invalid huge page policy '" << huge << "'" << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			HugePages::set_policy(policy, HugePages::kDefaultMinBlockBytes);
+		}
+		qconf.memory_limit = (size_t)cmd["memory_limit_mb"].as<int>() * 1024 * 1024;
+		qconf.spill_limit = (size_t)cmd["spill_limit_mb"].as<int>() * 1024 * 1024;
+		qconf.spill_dir = cmd["spill_dir"].as<std::string>();
+		if (qconf.spill_limit && qconf.memory_limit && qconf.spill_limit >= qconf.memory_limit) {
+			// spilling only starts, once the query would already have failed
+			std::cerr << "--spill_limit_mb must be below --memory_limit_mb" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		MemoryPool::set_limit((size_t)cmd["memory_pool_mb"].as<int>() * 1024 * 1024);
 
 		qconf.num_hot_reps= cmd["hot_runs"].as<int>();
 		qconf.scale_factor= scale_factor;
 		qconf.cxx_compiler = cmd["compiler"].as<std::string>();
+		qconf.compile_cache_dir = cmd["compile_cache"].as<std::string>();
 		qconf.write_result_to_file = cmd["result"].as<std::string>();
 		qconf.compare_result_to_file = cmd["compare"].as<std::string>();
 		qconf.write_profile_to_file = cmd["profile"].as<std::string>();
@@ -85,6 +151,21 @@ int main(int argc, char* argv[]) {
 		if (cmd.count("skip_translate")) {
 			qconf.skip_translate = true;
 		}
+		if (cmd.count("no-pch")) {
+			qconf.use_pch = false;
+		}
+		if (cmd.count("no-parallel-compile")) {
+			qconf.parallel_compile = false;
+		}
+		if (cmd.count("tiered")) {
+			qconf.tiered = true;
+		}
+		if (cmd.count("no-concurrent-pipelines")) {
+			qconf.concurrent_pipelines = false;
+		}
+		if (cmd.count("no-numa")) {
+			qconf.numa = false;
+		}
 
 #ifdef IS_DEBUG
 		qconf.optimized = false;
@@ -104,6 +185,36 @@ int main(int argc, char* argv[]) {
 		if (cmd.count("no-check")) {
 			qconf.check_result = false;
 		}
+		if (cmd.count("no-fingerprint")) {
+			qconf.check_fingerprint = false;
+		}
+
+		for (auto& param : split(cmd["param"].as<std::string>(), ',')) {
+			auto kv = split(param, '=');
+			size_t len = 0;
+			int64_t value = 0;
+			if (kv.size() == 2) {
+				try {
+					value = std::stoll(kv[1], &len);
+				} catch (const std::logic_error&) {
+					len = 0;
+				}
+			}
+			if (kv.size() != 2 || !len || len != kv[1].size()) {
+				std::cerr << "Invalid parameter binding '" << param << "'" << std::endl;
+				exit(1);
+			}
+			qconf.params[kv[0]] = value;
+
+			// expected results only hold for the default bindings
+			qconf.check_result = false;
+		}
+
+		if (cmd.count("concurrent_queries") && qconf.safe_mode) {
+			// safe mode forks a child per query, which would not share the scheduler
+			std::cerr << "--concurrent_queries cannot be combined with --safe" << std::endl;
+			exit(EXIT_FAILURE);
+		}
 
 		if (qconf.compare_result_to_file.size() > 0) {
 			qconf.check_result = true;			
@@ -111,6 +222,13 @@ int main(int argc, char* argv[]) {
 
 		const auto flavors = split(cmd["flavor"].as<std::string>(), ',');
 		const auto queries = split(cmd["q"].as<std::string>(), ',');
+		try {
+			check_tpch_params(qconf, queries);
+		} catch (const std::invalid_argument& e) {
+			std::cerr << e.what() << std::endl;
+			exit(1);
+		}
+		const auto priorities = split(cmd["priority"].as<std::string>(), ',');
 		const auto num_threads_collection = split(cmd["num_threads"].as<std::string>(), ',');
 		for (auto& threads : num_threads_collection) {
 			qconf.num_threads = std::stoi(threads);
@@ -137,15 +255,56 @@ int main(int argc, char* argv[]) {
 					exit(EXIT_FAILURE);		
 				}
 
-				for (auto& q : queries) {
-					Compiler compiler(0);
-					auto bq = prepare_tpch_query(qconf, q);
-					std::string res;
+				if (!cmd.count("concurrent_queries")) {
+					for (auto& q : queries) {
+						Compiler compiler(0);
+						auto bq = prepare_tpch_query(qconf, q);
+						std::string res;
+
+						res = compiler.compile(qconf, bq);
+						if (res.empty()) {
+							res = compiler.run(qconf, bq);
+						}
+					}
+					continue;
+				}
+
+				// compile all queries upfront, then run them at the same time
+				// sharing 'num_threads' slots
+				QueryScheduler scheduler(qconf.num_threads);
+				const size_t query_threads = cmd["query_threads"].as<int>();
+
+				std::vector<QueryConfig> configs;
+				std::vector<BenchmarkQuery> bqs;
+				std::vector<std::unique_ptr<Compiler>> compilers;
+				configs.reserve(queries.size());
+
+				for (size_t i=0; i<queries.size(); i++) {
+					configs.push_back(qconf);
+					auto& conf = configs.back();
+					conf.scheduler = &scheduler;
+					if (query_threads) {
+						conf.num_threads = std::min(query_threads, qconf.num_threads);
+					}
+					if (i < priorities.size()) {
+						conf.priority = std::stoi(priorities[i]);
+					}
+
+					compilers.emplace_back(new Compiler(i, "_q" + std::to_string(i)));
+					bqs.push_back(prepare_tpch_query(conf, queries[i]));
+				}
 
-					res = compiler.compile(qconf, bq);
-					if (res.empty()) {
-						res = compiler.run(qconf, bq);
+				std::vector<std::thread> runners;
+				for (size_t i=0; i<queries.size(); i++) {
+					if (!compilers[i]->compile(configs[i], bqs[i]).empty()) {
+						continue;
 					}
+					runners.emplace_back([&, i] () {
+						compilers[i]->run(configs[i], bqs[i]);
+					});
+				}
+				for (auto& r : runners) {
+					r.join();
 				}
 			}
 
@@ -133,6 +133,9 @@ PrintingPass::on_expression(LolepopCtx& ctx, ExprPtr& expr)
 		out << "!" << s.fun;
 		break;
 	case Expression::Type::Constant:
+		if (s.is_param()) {
+			out << "$" << s.param << "=";
+		}
 		out << "\"" << s.fun << "\"";
 		break;
 	case Expression::Type::Reference:
@@ -41,8 +41,8 @@ Const::Const(const std::string& val)
 
 }
 
-Const::Const(int64_t v)
- : RelExpr(RelExpr::Type::Const), val(std::to_string(v))
+Const::Const(int64_t v, const std::string& param)
+ : RelExpr(RelExpr::Type::Const), val(std::to_string(v)), param(param)
 {
 }
 
@@ -29,8 +29,11 @@ struct RelExpr {
 
 struct Const : RelExpr {
 	const std::string val;
+	//! Query parameter, empty for literals. Then 'val' only decides the type
+	const std::string param;
+
 	Const(const std::string& val);
-	Const(int64_t v);
+	Const(int64_t v, const std::string& param = "");
 
 	void accept(RelExprVisitor& visitor) final;
 };
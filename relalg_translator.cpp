@@ -1,7 +1,10 @@
 #include "utils.hpp"
 #include "relalg_translator.hpp"
 #include "runtime_framework.hpp"
+#include "common/runtime/Database.hpp"
+#include "common/runtime/Types.hpp"
 #include <functional>
+#include <algorithm>
 
 using namespace std;
 
@@ -57,6 +60,7 @@ public:
 
 	void visit(relalg::Const& c) final {
 		result = make_shared<Const>(c.val);
+		result->param = c.param;
 	}
 	
 	void visit(relalg::ColId& c) final {
@@ -171,11 +175,97 @@ RelOpTranslator::RelOpTranslator(QueryConfig& config)
 {
 }
 
+static void
+collect_accesses(const ExprPtr& e, std::unordered_set<std::string>& reads,
+	std::unordered_set<std::string>& writes)
+{
+	if (!e) {
+		return;
+	}
+
+	bool table_out, table_in;
+	std::string tbl, col;
+
+	if (e->is_get_morsel()) {
+		// morsels advance a cursor inside the data structure
+		writes.insert(e->args[0]->fun);
+	} else if (e->is_table_op(&table_out, &table_in)) {
+		e->get_table_column_ref(tbl, col);
+		if (table_in) {
+			reads.insert(tbl);
+		}
+		if (table_out) {
+			writes.insert(tbl);
+		}
+	} else if (e->is_get_pos()) {
+		// scan_pos and read_pos only access the morsel
+		if (!e->fun.compare("write_pos")) {
+			writes.insert(e->args[0]->fun);
+		}
+	} else if (e->get_table_column_ref(tbl, col)) {
+		reads.insert(tbl);
+	}
+
+	for (auto& arg : e->args) {
+		collect_accesses(arg, reads, writes);
+	}
+	collect_accesses(e->pred, reads, writes);
+}
+
+static void
+collect_accesses(const StmtPtr& s, std::unordered_set<std::string>& reads,
+	std::unordered_set<std::string>& writes)
+{
+	collect_accesses(s->expr, reads, writes);
+	collect_accesses(s->pred, reads, writes);
+
+	for (auto& child : s->statements) {
+		collect_accesses(child, reads, writes);
+	}
+}
+
+void
+RelOpTranslator::derive_dependencies(Pipeline& p)
+{
+	std::unordered_set<std::string> reads, writes;
+
+	for (auto& lolepop : p.lolepops) {
+		for (auto& stmt : lolepop->statements) {
+			collect_accesses(stmt, reads, writes);
+		}
+	}
+
+	auto intersects = [] (const auto& a, const auto& b) {
+		for (auto& x : a) {
+			if (b.find(x) != b.end()) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	// depend on earlier writers of what we touch and on earlier readers
+	// of what we write
+	p.dependencies.clear();
+	for (size_t i=0; i<pipeline_reads.size(); i++) {
+		if (intersects(reads, pipeline_writes[i]) ||
+				intersects(writes, pipeline_writes[i]) ||
+				intersects(writes, pipeline_reads[i])) {
+			p.dependencies.push_back(i);
+		}
+	}
+	p.dependencies_known = true;
+
+	pipeline_reads.emplace_back(std::move(reads));
+	pipeline_writes.emplace_back(std::move(writes));
+}
+
 void
 RelOpTranslator::new_pipeline()
 {
+	derive_dependencies(pipe);
 	prog.pipelines.push_back(std::move(pipe));
-	pipe.tag_interesting = true;
+	pipe = Pipeline();
 }
 
 void
@@ -377,24 +467,180 @@ RelOpTranslator::visit(relalg::Select& op)
 	pipe.lolepops.push_back(make_shared<Lolepop>(lolepop_name(op), statements));
 }
 
+//! Upper bound for the #groups from base table statistics, 0 if unknown.
+//! Only keys referring to base columns with a numeric domain are known.
+//! Ignores filters below the aggregation
+static size_t
+estimate_num_groups(QueryConfig& config,
+	const std::vector<std::shared_ptr<relalg::RelExpr>>& keys)
+{
+	double groups = 1;
+	size_t max_tuples = 0;
+
+	for (auto& key : keys) {
+		if (key->type != relalg::RelExpr::Type::ColId) {
+			return 0;
+		}
+
+		const auto& id = ((relalg::ColId*)key.get())->id;
+		const auto dot = id.find('.');
+		if (dot == std::string::npos || !config.db.hasRelation(id.substr(0, dot))) {
+			return 0;
+		}
+
+		auto& rel = config.db[id.substr(0, dot)];
+		auto attr = rel.attributes.find(id.substr(dot+1));
+		if (attr == rel.attributes.end()) {
+			return 0;
+		}
+
+		const MinMaxInfo* minmax = attr->second.minmax;
+		if (!minmax || (minmax->flags & MinMaxInfo::kVariableSize) ||
+				minmax->hi < minmax->lo) {
+			return 0;
+		}
+
+		groups *= std::min((double)rel.nrTuples, minmax->hi - minmax->lo + 1);
+		max_tuples = std::max(max_tuples, rel.nrTuples);
+	}
+
+	return std::min(groups, (double)max_tuples);
+}
+
+//! Upper bound for the #rows produced by 'op' from base table statistics,
+//! 0 if unknown. Ignores filters, joins produce at most their probe side
+static size_t
+estimate_cardinality(QueryConfig& config, relalg::RelOp& op)
+{
+	if (auto scan = dynamic_cast<relalg::Scan*>(&op)) {
+		return config.db.hasRelation(scan->table) ?
+			config.db[scan->table].nrTuples : 0;
+	}
+
+	const size_t child = op.left ? estimate_cardinality(config, *op.left) : 0;
+
+	if (auto aggr = dynamic_cast<relalg::HashAggr*>(&op)) {
+		if (aggr->variant == relalg::HashAggr::Global) {
+			return 1;
+		}
+		const size_t groups = estimate_num_groups(config, aggr->keys);
+		return groups && child ? std::min(groups, child) : child;
+	}
+
+	return child;
+}
+
+//! Whether a filter or join below 'op' can drop rows, in which case
+//! the estimates above are loose upper bounds
+static bool
+is_filtered(relalg::RelOp& op)
+{
+	if (dynamic_cast<relalg::Select*>(&op) || dynamic_cast<relalg::HashJoin*>(&op)) {
+		return true;
+	}
+	return (op.left && is_filtered(*op.left)) ||
+		(op.right && is_filtered(*op.right));
+}
+
+//! Reads all rows of 'table' morsel by morsel and emits 'out_cols' under
+//! 'pred'. Both refer to the current row position as 'pos'
+static StmtList
+read_table(const std::string& table, const std::vector<ExprPtr>& out_cols,
+	const ExprPtr& pred)
+{
+	ExprPtr no_pred = nullptr;
+
+	auto scan_morsel = make_shared<Ref>("morsel");
+	auto scan_morsel1 = make_shared<Ref>("morsel");
+	auto pos2 = make_shared<Ref>("pos");
+
+	return StmtList {
+		make_shared<Assign>("morsel",
+			make_shared<Fun>("read_morsel", ExprList {
+				make_shared<Ref>(table)
+			},
+			no_pred), no_pred),
+		make_shared<Assign>("valid_morsel",
+			make_shared<Fun>("selvalid", ExprList {
+				scan_morsel
+			},
+			no_pred), no_pred),
+		make_shared<Loop>(make_shared<Ref>("valid_morsel"), StmtList {
+			make_shared<Assign>("pos",
+				make_shared<Fun>("read_pos", ExprList { scan_morsel1 },
+				no_pred), no_pred),
+			make_shared<Assign>("valid_pos",
+				make_shared<Fun>("selvalid", ExprList { pos2 },
+				no_pred), no_pred),
+			make_shared<Loop>(make_shared<Ref>("valid_pos"), StmtList {
+				make_shared<Emit>(make_shared<TupleAppend>(out_cols, pred), pred),
+				make_shared<MetaRefillInflow>(),
+				make_shared<Assign>("pos", make_shared<Fun>("read_pos", ExprList { scan_morsel1 }, no_pred), no_pred),
+				make_shared<Assign>("valid_pos", make_shared<Fun>("selvalid", ExprList {make_shared<Ref>("pos")}, no_pred), no_pred)
+			}),
+
+			make_shared<MetaVarDead>("pos"),
+			make_shared<MetaVarDead>("valid_pos"),
+
+			make_shared<Assign>("morsel", make_shared<Fun>("read_morsel",
+				ExprList {make_shared<Ref>(table)}, no_pred), no_pred),
+			make_shared<Assign>("valid_morsel", make_shared<Fun>("selvalid",
+				ExprList {make_shared<Ref>("morsel")}, no_pred), no_pred)
+		}),
+		make_shared<MetaVarDead>("morsel"),
+		make_shared<MetaVarDead>("valid_morsel"),
+		make_shared<Done>()
+	};
+}
+
 void
 RelOpTranslator::visit(relalg::HashAggr& op)
 {
 	transl_op(*op.left);
 
 	std::vector<std::string> new_keys;
-	std::vector<std::string> new_aggregates;
+	// aggregates of the re-aggregation over the flushed partial results
+	std::vector<std::shared_ptr<relalg::RelExpr>> reaggregates;
 
 	const bool is_global_aggr = op.variant == relalg::HashAggr::Global;
 
+	// With many groups, each thread would pre-aggregate into an almost
+	// full copy of the table. Insert into one shared table instead.
+	// Only trust the estimate, if no filter or join reduces the input
+	const size_t num_groups = is_global_aggr ?
+		0 : estimate_num_groups(config, op.keys);
+	const bool shared = config.shared_aggr_min_groups &&
+		num_groups >= config.shared_aggr_min_groups &&
+		!is_filtered(*op.left) &&
+		!config.open_addressing;
+
+	// Presize the indexes, so that they rarely grow while inserting.
+	// Thread-local tables see a share of the input, re-aggregation
+	// sizes its index per flush partition. The estimate is a loose upper
+	// bound, hence thread-local indexes are presized to at most a cache
+	// resident size and grow beyond that
+	const size_t kMaxPreaggrGroups = 64*1024;
+	const size_t num_threads = std::max(config.num_threads, (size_t)1);
+	const size_t input_rows = estimate_cardinality(config, *op.left);
+	const size_t preaggr_groups = std::min(kMaxPreaggrGroups, input_rows ?
+		std::min(num_groups, (input_rows + num_threads - 1) / num_threads) :
+		num_groups);
+
+	std::string preaggr_table;
+
 	auto generate_aggregation = [&] (relalg::HashAggr& op, bool reaggr) {
-		const bool flush_to_master = !reaggr;
+		const bool flush_to_master = !reaggr && !shared;
+		// partial results are re-aggregated, the last phase produces the result
+		const bool final_phase = !flush_to_master || is_global_aggr;
 		auto struct_name = new_unique_name("aggr_ht");
 
 		std::vector<StmtPtr> stmts;
 		std::vector<StmtPtr> aggrs;
 		std::vector<std::string> key_columns;
-		std::vector<std::string> aggregate_columns;
+		// output columns, AVG is divided by its count column (second)
+		std::vector<std::pair<std::string, std::string>> aggregate_columns;
+		// initializes MIN/MAX of newly inserted groups with the first value
+		std::vector<StmtPtr> init_aggregates;
 
 		std::vector<DCol> table_cols;
 
@@ -410,55 +656,112 @@ RelOpTranslator::visit(relalg::HashAggr& op)
 		size_t aggr_idx = 0;
 		std::string count_colum = "";
 
-		auto add_aggregate = [&] (auto aggr, bool visible, auto& pred, bool global) {
-			const auto short_col_name = "aggr_" + std::to_string(aggr_idx);
+		auto aggregate_column = [&] (const std::string& short_col_name,
+				const std::string& fun, auto& pred, bool global,
+				const std::shared_ptr<relalg::RelExpr>& arg) {
 			const auto col_name = struct_name + "." + short_col_name;
-			ASSERT(aggr->type == relalg::RelExpr::Type::Fun);
+			auto col = make_shared<Ref>(col_name);
 
 			ExprTranslator transl(flow, pred);
-
-			auto f = (relalg::Fun*)aggr.get();
-			ASSERT(f);
-			const auto& n = f->name;
+			ExprPtr val = arg ? transl(arg) : nullptr;
 			StmtPtr s = nullptr;
-			ASSERT(f->args.size() <= 1);
-
-			aggr_idx++;
 
 			table_cols.push_back(DCol(short_col_name, short_col_name, DCol::Modifier::kValue));
 
 			if (global) {
-				if (!n.compare("sum")) {
-					auto& arg = f->args[0];
-					s = make_shared<AggrGSum>(make_shared<Ref>(col_name),
-						transl(arg), pred);
-				} else if (!n.compare("count")) {
-					count_colum = col_name;
-					s = make_shared<AggrGCount>(make_shared<Ref>(col_name),
-						pred);
+				if (!fun.compare("sum")) {
+					s = make_shared<AggrGSum>(col, val, pred);
+				} else if (!fun.compare("count")) {
+					s = make_shared<AggrGCount>(col, pred);
+				} else if (!fun.compare("min")) {
+					s = make_shared<AggrGMin>(col, val, pred);
+				} else if (!fun.compare("max")) {
+					s = make_shared<AggrGMax>(col, val, pred);
 				} else {
 					ASSERT(false && "invalid aggregate function");
 				}
+				table_cols.back().combine = fun;
 			} else {
-				if (!n.compare("sum")) {
-					auto& arg = f->args[0];
-					s = make_shared<AggrSum>(make_shared<Ref>(col_name), group_id,
-						transl(arg), pred);
-				} else if (!n.compare("count")) {
-					count_colum = col_name;
-					s = make_shared<AggrCount>(make_shared<Ref>(col_name), group_id,
-						group_id, pred);
+				if (!fun.compare("sum")) {
+					s = make_shared<AggrSum>(col, group_id, val, pred);
+				} else if (!fun.compare("count")) {
+					s = make_shared<AggrCount>(col, group_id, group_id, pred);
+				} else if (!fun.compare("min")) {
+					s = make_shared<AggrMin>(col, group_id, val, pred);
+				} else if (!fun.compare("max")) {
+					s = make_shared<AggrMax>(col, group_id, val, pred);
 				} else {
 					ASSERT(false && "invalid aggregate function");
 				}
+
+				if (!fun.compare("min") || !fun.compare("max")) {
+					ExprPtr scatter_pred = make_shared<Ref>("can_scatter");
+					ExprTranslator init_transl(flow, scatter_pred);
+
+					init_aggregates.push_back(make_shared<Scatter>(col,
+						make_shared<Ref>("new_pos"), init_transl(arg), scatter_pred));
+				}
+			}
+
+			aggrs.push_back(s);
+			return col_name;
+		};
+
+		auto add_aggregate = [&] (auto aggr, bool visible, auto& pred, bool global) {
+			const auto short_col_name = "aggr_" + std::to_string(aggr_idx);
+			ASSERT(aggr->type == relalg::RelExpr::Type::Fun);
+
+			auto f = (relalg::Fun*)aggr.get();
+			ASSERT(f);
+			const auto& n = f->name;
+
+			aggr_idx++;
+
+			if (!n.compare("avg")) {
+				// sum and count, divided when producing the result. Partial
+				// results come as avg(sum, count)
+				ASSERT(f->args.size() == 1 || f->args.size() == 2);
+				const bool partial = f->args.size() == 2;
+
+				auto sum = aggregate_column(short_col_name, "sum", pred, global,
+					f->args[0]);
+				auto count = aggregate_column(short_col_name + "_count",
+					partial ? "sum" : "count", pred, global,
+					partial ? f->args[1] : nullptr);
+
+				if (!visible) {
+					return;
+				}
+				if (final_phase) {
+					aggregate_columns.push_back({sum, count});
+					return;
+				}
+
+				aggregate_columns.push_back({sum, ""});
+				aggregate_columns.push_back({count, ""});
+				reaggregates.push_back(make_shared<relalg::Fun>("avg",
+					relalg::RelExpr::from_column_names({sum, count})));
+				return;
+			}
+
+			ASSERT(f->args.size() <= 1);
+			auto col_name = aggregate_column(short_col_name, n, pred, global,
+				f->args.empty() || !n.compare("count") ? nullptr : f->args[0]);
+
+			if (!n.compare("count")) {
+				count_colum = col_name;
 			}
 
-			if (visible) {
-				aggregate_columns.push_back(col_name);
+			if (!visible) {
+				return;
 			}
 
-			if (s) {
-				aggrs.push_back(s);
+			aggregate_columns.push_back({col_name, ""});
+			if (!final_phase) {
+				// counts of the partial results add up
+				reaggregates.push_back(make_shared<relalg::Fun>(
+					n.compare("count") ? n : std::string("sum"),
+					relalg::RelExpr::from_column_names({col_name})));
 			}
 		};
 
@@ -554,6 +857,9 @@ RelOpTranslator::visit(relalg::HashAggr& op)
 			auto found_pred = make_shared<Ref>("found");
 
 			const auto aggregates = generate_aggregates(found_pred, false);
+			for (auto& init : init_aggregates) {
+				scatter_keys.push_back(init);
+			}
 
 			StmtPtr compute_aggregates = make_shared<WrapStatements>(aggregates, found_pred);
 			if (false && aggregates.size() > 0 && (config.all_blends || config.full_blend || !config.blend_aggregates.empty())) {
@@ -577,6 +883,15 @@ RelOpTranslator::visit(relalg::HashAggr& op)
 				));
 			}
 
+			if (shared) {
+				// publish the new group, once keys and hash are written. Loses
+				// against another thread with the same keys, see shared_link()
+				scatter_keys.push_back(make_shared<Effect>(make_shared<Fun>("bucket_link", ExprList {
+					make_shared<Ref>(struct_name),
+					make_shared<Ref>("new_pos")
+				}, scatter_pred)));
+			}
+
 			StmtPtr match_keys_stmt = create_match_keys_no_blend("equal", check_expr, hit_pred);
 
 			auto outer_loop = make_shared<Loop>(make_shared<Ref>("miss"), StmtList {
@@ -657,13 +972,28 @@ RelOpTranslator::visit(relalg::HashAggr& op)
 		}
 
 		auto table_type = DataStructure::kHashTable;
-		DataStructure::Flags flags = DataStructure::kThreadLocal;
+		DataStructure::Flags flags = shared ?
+			DataStructure::kDefault : DataStructure::kThreadLocal;
 		if (flush_to_master) {
 			flags |= DataStructure::kFlushToMaster;
 		}
+		if (config.open_addressing) {
+			flags |= DataStructure::kOpenAddressing;
+		}
+		if (is_global_aggr) {
+			flags |= DataStructure::kGlobalAggregate;
+		}
 
 		prog.data_structures.push_back(Table(struct_name, { table_cols }, table_type,
 			flags));
+		prog.data_structures.back().cardinality = shared ? num_groups :
+			reaggr ? 0 : preaggr_groups;
+		if (flush_to_master) {
+			preaggr_table = struct_name;
+		}
+		if (reaggr) {
+			prog.data_structures.back().merges = preaggr_table;
+		}
 
 		pipe.lolepops.push_back(make_shared<Lolepop>(lolepop_name(op, "build"), std::move(stmts)));
 
@@ -673,7 +1003,8 @@ RelOpTranslator::visit(relalg::HashAggr& op)
 
 		new_pipeline();
 
-		if (flush_to_master) {
+		// global aggregates are combined when read, see kGlobalAggregate
+		if (flush_to_master && !is_global_aggr) {
 			ExprPtr lolepred_build = nullptr;
 
 			auto statements = StmtList {
@@ -700,79 +1031,52 @@ RelOpTranslator::visit(relalg::HashAggr& op)
 		pred = make_shared<Fun>("gt", ExprList {count, make_shared<Const>("0")}, no_pred);
 		pred = make_shared<Fun>("seltrue", ExprList {pred}, no_pred);			
 
-		auto pos2 = make_shared<Ref>("pos");
-
 		std::vector<ExprPtr> out_cols;
 		Flow new_flow;
 		size_t output_col_id = 0;
 
-		auto add_out_col = [&] (const auto& name) {
+		auto read_col = [&] (const auto& name) -> ExprPtr {
 			ASSERT(name.size() > 0);
-			out_cols.push_back(make_shared<Fun>("read", ExprList {make_shared<Ref>(name), pos}, no_pred));
+			return make_shared<Fun>("read", ExprList {make_shared<Ref>(name), pos}, no_pred);
+		};
+
+		auto add_out_col = [&] (const auto& name, const ExprPtr& expr) {
+			out_cols.push_back(expr);
 			new_flow.col_map[name] = output_col_id;
 			output_col_id++;
 		};
 
 		for (auto& col : key_columns) {
-			add_out_col(col);
+			add_out_col(col, read_col(col));
 			new_keys.push_back(col);
 		}
 
 		for (auto& col : aggregate_columns) {
-			add_out_col(col);
-			new_aggregates.push_back(col);
-		}
-
-
-		auto scan_morsel = make_shared<Ref>("morsel");
-		auto scan_morsel1 = make_shared<Ref>("morsel");
+			if (col.second.empty()) {
+				add_out_col(col.first, read_col(col.first));
+				continue;
+			}
 
-		{
-			auto stmts = StmtList {
-				make_shared<Assign>("morsel",
-					make_shared<Fun>("read_morsel", ExprList {
-						make_shared<Ref>(struct_name)
-					},
-					no_pred), no_pred),
-				make_shared<Assign>("valid_morsel",
-					make_shared<Fun>("selvalid", ExprList {
-						scan_morsel
-					},
-					no_pred), no_pred),
-				make_shared<Loop>(make_shared<Ref>("valid_morsel"), StmtList {
-					make_shared<Assign>("pos",
-						make_shared<Fun>("read_pos", ExprList { scan_morsel1 },
-						no_pred), no_pred),
-					make_shared<Assign>("valid_pos",
-						make_shared<Fun>("selvalid", ExprList { pos2 },
-						no_pred), no_pred),
-					make_shared<Loop>(make_shared<Ref>("valid_pos"), StmtList {
-						make_shared<Emit>(make_shared<TupleAppend>(out_cols, pred), pred),
-						make_shared<MetaRefillInflow>(),
-						make_shared<Assign>("pos", make_shared<Fun>("read_pos", ExprList { scan_morsel1 }, no_pred), no_pred),
-						make_shared<Assign>("valid_pos", make_shared<Fun>("selvalid", ExprList {make_shared<Ref>("pos")}, no_pred), no_pred)
-					}),
-
-					make_shared<MetaVarDead>("pos"),
-					make_shared<MetaVarDead>("valid_pos"),
-
-					make_shared<Assign>("morsel", make_shared<Fun>("read_morsel",
-						ExprList {make_shared<Ref>(struct_name)}, no_pred), no_pred),
-					make_shared<Assign>("valid_morsel", make_shared<Fun>("selvalid",
-						ExprList {make_shared<Ref>("morsel")}, no_pred), no_pred)
-				}),
-				make_shared<MetaVarDead>("morsel"),
-				make_shared<MetaVarDead>("valid_morsel"),
-				make_shared<Done>()
-			};
+			// late division of AVG, i.e. sum / count rounded, see voila_div().
+			// 'pred' only reads groups with rows, the count is never 0
+			add_out_col(col.first, make_shared<Fun>("div", ExprList {
+				read_col(col.first), read_col(col.second)}, no_pred));
+		}
 
 
-			pipe.lolepops.push_back(make_shared<Lolepop>(lolepop_name(op, "read"), stmts));		
-		}
+		pipe.lolepops.push_back(make_shared<Lolepop>(lolepop_name(op, "read"),
+			read_table(struct_name, out_cols, pred)));
 
 		flow = new_flow;
 	};
 
+	if (shared || is_global_aggr) {
+		// single phase, but keep the name the re-aggregation table would have
+		new_unique_name("aggr_ht");
+		generate_aggregation(op, false);
+		return;
+	}
+
 	generate_aggregation(op, false);
 
 	// morsel-driven parallelism requires re-aggregation on partitions
@@ -780,38 +1084,120 @@ RelOpTranslator::visit(relalg::HashAggr& op)
 		// auto dummy = make_shared<Scan>("", {});
 		std::vector<std::shared_ptr<relalg::RelExpr>> key_cols
 			= relalg::RelExpr::from_column_names(new_keys);
-		std::vector<std::shared_ptr<relalg::RelExpr>> agg_cols
-			= relalg::RelExpr::from_column_names(new_aggregates);
 
-		std::vector<std::shared_ptr<relalg::RelExpr>> aggregates;
-		for (size_t i=0; i<agg_cols.size(); i++) {
-			shared_ptr<relalg::RelExpr>& col = agg_cols[i];
-			auto& aggr = op.aggregates[i];
+		relalg::HashAggr reaggr(op.variant,
+			nullptr, key_cols, reaggregates);
+		generate_aggregation(reaggr, true);
+	}
+}
 
-			ASSERT(aggr->type == relalg::RelExpr::Type::Fun);
+void
+RelOpTranslator::partition_probe_side(relalg::HashJoin& op,
+	const std::string& build_table, size_t partition_pipeline)
+{
+	const std::string struct_name = new_unique_name("join_probe");
+	ExprPtr no_pred = nullptr;
+	ExprPtr lolepred_write = make_shared<LolePred>();
+	ExprPtr wpos = make_shared<Ref>("wpos");
+	ExprPtr pos = make_shared<Ref>("pos");
+	auto lolearg = make_shared<LoleArg>();
 
-			auto f = (relalg::Fun*)aggr.get();
-			ASSERT(f);
-			auto n = f->name;
+	ExprTranslator transl(flow, lolepred_write);
 
-			if (!n.compare("count")) {
-				n = "sum";
-			}
+	StmtList statements = {
+		make_shared<Assign>("wpos",
+			make_shared<Fun>("write_pos", ExprList {
+				make_shared<Ref>(struct_name),
+				lolepred_write,
+			}, lolepred_write),
+			lolepred_write)
+	};
 
-			std::shared_ptr<relalg::Fun> c(new relalg::Fun(n, {col}));
-			aggregates.push_back(c);
-		}
+	std::vector<DCol> table_cols;
+	std::vector<ExprPtr> read_cols;
+	Flow read_flow;
 
-		relalg::HashAggr reaggr(op.variant,
-			nullptr, key_cols, aggregates);
-		generate_aggregation(reaggr, true);
+	// keep the column order stable
+	std::vector<std::pair<size_t, std::string>> columns;
+	for (auto& col : flow.col_map) {
+		columns.emplace_back(col.second, col.first);
+	}
+	std::sort(columns.begin(), columns.end());
+
+	for (auto& col : columns) {
+		const std::string tbl_col_short("col" + std::to_string(read_cols.size()));
+		const std::string tbl_col(struct_name + "." + tbl_col_short);
+
+		table_cols.push_back(DCol(tbl_col_short, tbl_col_short, DCol::Modifier::kValue));
+		statements.push_back(make_shared<Write>(make_shared<Ref>(tbl_col), wpos,
+			make_shared<TupleGet>(lolearg, col.first), lolepred_write));
+
+		read_flow.col_map[col.second] = read_cols.size();
+		read_cols.push_back(make_shared<Fun>("read", ExprList {
+			make_shared<Ref>(tbl_col), pos}, no_pred));
+	}
+
+	// same hash as the build side, the partition is derived from it
+	ExprPtr hash_keys = nullptr;
+	for (auto& key : op.left_keys) {
+		ExprPtr k = transl(key);
+		hash_keys = hash_keys ?
+			make_shared<Fun>("rehash", ExprList { hash_keys, k }, lolepred_write) :
+			make_shared<Fun>("hash", ExprList { k }, lolepred_write);
+	}
+
+	{
+		const std::string tbl_col_short("hash" + std::to_string(read_cols.size()));
+		table_cols.push_back(DCol(tbl_col_short, tbl_col_short, DCol::Modifier::kHash));
+		statements.push_back(make_shared<Write>(
+			make_shared<Ref>(struct_name + "." + tbl_col_short), wpos, hash_keys,
+			lolepred_write));
+	}
+	statements.push_back(make_shared<MetaVarDead>("wpos"));
+
+	pipe.lolepops.push_back(make_shared<Lolepop>(lolepop_name(op, "probe_materialize"),
+		StmtList { wrap_blend(true, config, statements, lolepred_write) }));
+
+	new_pipeline();
+
+	prog.data_structures.push_back(Table{ struct_name, { table_cols },
+		DataStructure::kHashTable,
+		DataStructure::kThreadLocal | DataStructure::kFlushToMaster});
+	prog.data_structures.back().partitioned_like = build_table;
+
+	// -------------------- partition probe side ---------------------------
+	{
+		statements = {
+			make_shared<Effect>(make_shared<Fun>("bucket_flush", ExprList {
+					make_shared<Ref>(struct_name)
+				}, no_pred)),
+			make_shared<Done>()
+		};
+
+		pipe.lolepops.push_back(make_shared<Lolepop>(lolepop_name(op, "probe_partition"),
+			statements));
+		pipe.tag_interesting = false;
+		new_pipeline();
+
+		// needs the #partitions of the build side, which no expression refers to
+		prog.pipelines.back().dependencies.push_back(partition_pipeline);
 	}
+
+	pipe.lolepops.push_back(make_shared<Lolepop>(lolepop_name(op, "probe_read"),
+		read_table(struct_name, read_cols, no_pred)));
+
+	flow = read_flow;
 }
 
 void
 RelOpTranslator::visit(relalg::HashJoin& op)
 {
 	std::string struct_name = new_unique_name("join_ht");
+	const size_t join_id = join_counter++;
+
+	// build sides much larger than the caches are partitioned first
+	const bool radix = config.use_radix_join(join_id,
+		estimate_cardinality(config, *op.right));
 
 	std::vector<std::string> keys;
 
@@ -908,8 +1294,35 @@ RelOpTranslator::visit(relalg::HashJoin& op)
 
 	new_pipeline();
 	//
+	DataStructure::Flags flags = DataStructure::kReadAfterWrite;
+	if (config.use_open_addressing_join(join_id)) {
+		flags |= DataStructure::kOpenAddressing;
+	}
+	if (radix) {
+		flags |= DataStructure::kRadixPartitioned;
+	}
 	prog.data_structures.push_back(Table{ struct_name, { table_cols },
-		DataStructure::kHashTable, DataStructure::kReadAfterWrite});
+		DataStructure::kHashTable, flags});
+
+	// -------------------- partition build side ---------------------------
+	size_t partition_pipeline = 0;
+	if (radix) {
+		ExprPtr lolepred_partition = nullptr;
+
+		statements = {
+			make_shared<Effect>(make_shared<Fun>("bucket_flush", ExprList {
+					make_shared<Ref>(struct_name)
+				}, lolepred_partition)),
+			make_shared<Done>()
+		};
+
+		pipe.lolepops.push_back(make_shared<Lolepop>(lolepop_name(op, "partition"), statements));
+		pipe.tag_interesting = false;
+		statements.clear();
+
+		partition_pipeline = prog.pipelines.size();
+		new_pipeline();
+	}
 
 	// -------------------- build HT ------------------------------------
 	{
@@ -935,6 +1348,10 @@ RelOpTranslator::visit(relalg::HashJoin& op)
 		flow = Flow(); // debug, will be overwritten
 		transl_op(*op.left);
 
+		if (radix) {
+			partition_probe_side(op, struct_name, partition_pipeline);
+		}
+
 		ExprPtr lolepred_probe = make_shared<LolePred>();
 
 		ExprTranslator left_transl(flow, lolepred_probe);
@@ -5,6 +5,7 @@
 #include "voila.hpp"
 
 #include <unordered_map>
+#include <unordered_set>
 
 struct Flow {
 	typedef std::unordered_map<std::string, size_t> ColumnMapping;
@@ -25,6 +26,9 @@ struct RelOpTranslator : relalg::RelOpVisitor {
 
 	size_t id_counter = 0;
 
+	//! Number of the next HashJoin, see QueryConfig::open_addressing_joins
+	size_t join_counter = 0;
+
 	std::string new_unique_name(const std::string& prefix = "") {
 		return prefix + std::to_string(id_counter++);
 	}
@@ -46,6 +50,21 @@ struct RelOpTranslator : relalg::RelOpVisitor {
 
 	Program prog;
 
+private:
+	//! Data structures read and written by each finished pipeline
+	std::vector<std::unordered_set<std::string>> pipeline_reads;
+	std::vector<std::unordered_set<std::string>> pipeline_writes;
+
+	void derive_dependencies(Pipeline& p);
+
+	//! Radix join: materializes the current flow into partitions like the
+	//! build side 'build_table', which 'partition_pipeline' partitions.
+	//! Continues the flow by reading it back a partition at a time
+	void partition_probe_side(relalg::HashJoin& op, const std::string& build_table,
+		size_t partition_pipeline);
+
+public:
+
 	RelOpTranslator(QueryConfig& config);
 
 	void operator()(relalg::RelOp& op);
@@ -586,6 +586,21 @@ avx512_bucket_lookup(sel_t* RESTRICT sel, sel_t num, u64* RESTRICT res,
 	if (sel) {
 #ifdef __AVX512F__
 		const auto vmask = _mm512_set1_epi64(mask);
+		const auto vptr_mask = _mm512_set1_epi64(BucketTag::kPointerMask);
+		const auto vone = _mm512_set1_epi64(1);
+		const auto vfifteen = _mm512_set1_epi64(15);
+		const auto vtag_shift = _mm512_set1_epi64(BucketTag::kPointerBits);
+
+		// see BucketTag::lookup()
+		auto lookup = [&] (__m512i hash) {
+			auto head = _mm512_i64gather_epi64(_mm512_and_epi64(hash, vmask),
+				buckets, 8);
+			auto shift = _mm512_add_epi64(vtag_shift,
+				_mm512_and_epi64(_mm512_srli_epi64(hash, 32), vfifteen));
+			auto tagged = _mm512_test_epi64_mask(head,
+				_mm512_sllv_epi64(vone, shift));
+			return _mm512_maskz_and_epi64(tagged, head, vptr_mask);
+		};
 
 		for (;i+16<num; i+=16) {
 			__m256i sids_a = _mm256_loadu_si256((__m256i*)(sel+i));
@@ -594,11 +609,8 @@ avx512_bucket_lookup(sel_t* RESTRICT sel, sel_t num, u64* RESTRICT res,
 			auto idx64_a =_mm512_i32gather_epi64(sids_a, index, 8);
 			auto idx64_b =_mm512_i32gather_epi64(sids_b, index, 8);
 
-			idx64_a = _mm512_and_epi64(idx64_a, vmask);
-			idx64_b = _mm512_and_epi64(idx64_b, vmask);
-			
-			idx64_a = _mm512_i64gather_epi64(idx64_a, buckets, 8);
-			idx64_b = _mm512_i64gather_epi64(idx64_b, buckets, 8);
+			idx64_a = lookup(idx64_a);
+			idx64_b = lookup(idx64_b);
 
 			_mm512_i32scatter_epi64(res, sids_a, idx64_a, 8);
 			_mm512_i32scatter_epi64(res, sids_b, idx64_b, 8);
@@ -607,12 +619,12 @@ avx512_bucket_lookup(sel_t* RESTRICT sel, sel_t num, u64* RESTRICT res,
 
 		for (;i<num; i++) {
 			auto k = sel[i];
-			res[k] = buckets[index[k] & mask];
+			res[k] = BucketTag::lookup(buckets[index[k] & mask], index[k]);
 		}
 	} else {
 		for (;i<num; i++) {
 			auto k = i;
-			res[k] = buckets[index[k] & mask];
+			res[k] = BucketTag::lookup(buckets[index[k] & mask], index[k]);
 		}
 	}
 
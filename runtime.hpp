@@ -147,6 +147,28 @@ inline u32 extract_year(u32 date)
    return year;
 }
 
+//! Late division of AVG, sum 'a' by count 'b'. Rounds half away from zero
+//! and keeps the type, i.e. the decimal scale, of the sum. Groups without
+//! rows are never read, see the count predicate of HashAggr's read. Their
+//! 0 just avoids the trap
+template<typename T, typename U>
+inline T voila_div(const T& a, const U& b)
+{
+	if (!b) {
+		return 0;
+	}
+
+	// an unsigned count would turn a negative sum unsigned
+	const T d = (T)b;
+	const T half = d / 2;
+	if constexpr ((T)-1 < (T)0) {
+		if (a < 0) {
+			return (a - half) / d;
+		}
+	}
+	return (a + half) / d;
+}
+
 struct varchar {
 	uint16_t len;
 	const char* arr = nullptr;
@@ -534,6 +556,33 @@ T __clite_print(const T& x, const std::string& msg, const std::string& file, int
 	return x;
 }
 
+//! Tags in the unused upper bits of chained bucket heads. Each row in the
+//! chain sets one bit, chosen by its hash, so probes can reject most
+//! misses without following the head. Rows' next pointers are untagged.
+struct BucketTag {
+	static constexpr u64 kPointerBits = 48;
+	static constexpr u64 kPointerMask = (1ull << kPointerBits) - 1;
+
+	//! Bits 32..35 of the hash, the upper bits are weak for small keys
+	static u64 tag(u64 hash) {
+		return 1ull << (kPointerBits + ((hash >> 32) & 15));
+	}
+
+	static u64 ptr(u64 head) {
+		return head & kPointerMask;
+	}
+
+	//! New head after prepending 'row' to the chain of 'old'
+	static u64 head(u64 old, u64 row, u64 hash) {
+		return row | (old & ~kPointerMask) | tag(hash);
+	}
+
+	//! First row of the chain, 0 if the tag rules out 'hash'
+	static u64 lookup(u64 head, u64 hash) {
+		return (head & tag(hash)) ? ptr(head) : 0;
+	}
+};
+
 
 void prefetch_bucket_lookup(sel_t* sel, sel_t num, int temporality, void** table, u64* hash, u64 mask);
 void prefetch_bucket_next(sel_t* sel, sel_t num, int temporality, void** bucket, u64 offset);
@@ -738,6 +787,5 @@ struct Vectorized {
 
 uint64_t rdtsc();
 
-static const u64 kGlobalAggrHashVal=42;
 
 #endif 
\ No newline at end of file
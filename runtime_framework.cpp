@@ -2,8 +2,10 @@
 #include "runtime_utils.hpp"
 #include "runtime_struct.hpp"
 #include "runtime_vector.hpp"
+#include "runtime_scheduler.hpp"
 #include "build.hpp"
 #include <tbb/tbb.h>
+#include <functional>
 
 std::string write_strFrom_Flavor(QueryConfig::Flavor b) {
 	switch (b) {
@@ -52,69 +54,339 @@ QueryConfig::write(std::ostream& o, const std::string& sep)
 #undef WRITE
 }
 
+void
+QueryConfig::declare_param(const std::string& name, int64_t dflt)
+{
+	declared_params.insert(name);
+
+	auto it = params.find(name);
+	if (it == params.end()) {
+		params[name] = dflt;
+		return;
+	}
+
+	// same type as TypingPass gives the parameter
+	int64_t min = std::numeric_limits<int64_t>::min();
+	int64_t max = std::numeric_limits<int64_t>::max();
+	for (int bits : { 8, 16, 32 }) {
+		const int64_t lo = -(1ll << (bits-1));
+		const int64_t hi = (1ll << (bits-1)) - 1;
+		if (dflt >= lo && dflt <= hi) {
+			min = lo;
+			max = hi;
+			break;
+		}
+	}
+
+	const int64_t v = it->second;
+	if (v < min || v > max) {
+		throw std::invalid_argument("Query parameter '" + name + "' = " +
+			std::to_string(v) + " out of range [" + std::to_string(min) +
+			", " + std::to_string(max) + "]");
+	}
+}
+
+void
+QueryConfig::check_params() const
+{
+	for (auto& param : params) {
+		if (!declared_params.count(param.first)) {
+			throw std::invalid_argument("Unknown query parameter '" +
+				param.first + "'");
+		}
+	}
+}
+
+static std::atomic<uint64_t> g_result_epoch(1);
+
+QueryResult::QueryResult()
+ : epoch(g_result_epoch++)
+{
+}
+
 void
 QueryResult::reset()
 {
 	if (init) {
-		printf("got %d rows\n", rowid);
+		printf("got %d rows\n", (int)num_rows());
 	} else {
 		init = true;
 	}
-	colid = 0;
-	rowid = 0;
 
-	gathered.clear();
-	gathered.str("");
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// invalidate the threads' cached buffers
+	epoch = g_result_epoch++;
+	buffers.clear();
+
+	formatted.clear();
+	is_formatted = false;
 }
 
-void
-QueryResult::begin_line()
+QueryResult::Buffer&
+QueryResult::get_buffer()
 {
-	mutex.lock();
+	// a few entries, threads might serve multiple queries at the same time
+	static constexpr size_t kCacheSize = 4;
+	struct CacheEntry {
+		uint64_t epoch = 0;
+		Buffer* buffer = nullptr;
+	};
+	static thread_local CacheEntry cache[kCacheSize];
+	static thread_local size_t cache_next = 0;
+
+	for (auto& e : cache) {
+		if (e.epoch == epoch) {
+			return *e.buffer;
+		}
+	}
+
+	Buffer* buffer = new Buffer();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		buffers.emplace_back(buffer);
+	}
+
+	auto& e = cache[cache_next];
+	cache_next = (cache_next + 1) % kCacheSize;
+	e.epoch = epoch;
+	e.buffer = buffer;
+	return *buffer;
 }
 
 void
-QueryResult::push_col(const std::string& s)
+QueryResult::append(Column& col, const varchar& val)
 {
-	if (colid) {
-		gathered << "|";
-//		printf("|");
+	if (!col.format) {
+		col.format = &format_varchar;
 	}
-	gathered << s; 
-	colid++;
+	ASSERT(col.format == &format_varchar && "Column type changed");
+
+	const uint64_t loc[2] = { col.heap.size(), val.len };
+	col.heap.insert(col.heap.end(), val.arr, val.arr + val.len);
+
+	const size_t offset = col.data.size();
+	col.data.resize(offset + sizeof(loc));
+	memcpy(&col.data[offset], &loc[0], sizeof(loc));
+}
 
-//	printf("%s", s.c_str());
+void
+QueryResult::format_varchar(std::string& out, const Column& col, size_t row)
+{
+	uint64_t loc[2];
+	memcpy(&loc[0], &col.data[row * sizeof(loc)], sizeof(loc));
+	out.append(&col.heap[loc[0]], loc[1]);
 }
 
 void
-QueryResult::push_col(const char* buf, size_t len)
+QueryResult::begin_line()
 {
-	push_col(std::string(buf, len));
+	get_buffer().colid = 0;
 }
 
 void
 QueryResult::end_line()
 {
-	// printf("\n");
-	gathered << std::endl;
-	colid=0;
-	rowid++;
-	// printf("\n");
+	auto& buf = get_buffer();
+	ASSERT(buf.colid == buf.cols.size());
+	buf.colid = 0;
+	buf.rows++;
+}
 
-	mutex.unlock();
+size_t
+QueryResult::num_rows()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	size_t r = 0;
+	for (auto& buf : buffers) {
+		r += buf->rows;
+	}
+	return r;
 }
 
 std::string
 QueryResult::finalize()
 {
-	return gathered.str();
+	std::lock_guard<std::mutex> lock(mutex);
+	if (is_formatted) {
+		return formatted;
+	}
+
+	for (auto& buf : buffers) {
+		for (size_t row=0; row<buf->rows; row++) {
+			format_row(formatted, *buf, row);
+			formatted += '\n';
+		}
+	}
+
+	is_formatted = true;
+	return formatted;
+}
+
+void
+QueryResult::format_row(std::string& out, const Buffer& buf, size_t row) const
+{
+	for (size_t col=0; col<buf.cols.size(); col++) {
+		if (col) {
+			out += '|';
+		}
+		auto& c = buf.cols[col];
+		c.format(out, c, row);
+	}
+}
+
+ResultFingerprint
+QueryResult::fingerprint()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::mutex fp_mutex;
+	ResultFingerprint r;
+
+	tbb::parallel_for<size_t>(0, buffers.size(), 1, [&] (size_t i) {
+		auto& buf = *buffers[i];
+		ResultFingerprint local;
+		std::string line;
+
+		for (size_t row=0; row<buf.rows; row++) {
+			line.clear();
+			format_row(line, buf, row);
+			local.add_row(line.data(), line.size());
+		}
+
+		std::lock_guard<std::mutex> lock(fp_mutex);
+		r.add(local);
+	});
+
+	return r;
+}
+
+static uint64_t
+fingerprint_hash(const char* s, size_t len)
+{
+	// FNV-1a, stable across builds unlike std::hash
+	uint64_t h = 14695981039346656037ull;
+	for (size_t i=0; i<len; i++) {
+		h ^= (uint8_t)s[i];
+		h *= 1099511628211ull;
+	}
+
+	// finalizer from MurmurHash3, spreads bits for the sum
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+void
+ResultFingerprint::add_row(const char* row, size_t len)
+{
+	const uint64_t h = fingerprint_hash(row, len);
+	rows++;
+	sum += h;
+	xor_sum ^= h;
+}
+
+void
+ResultFingerprint::add(const ResultFingerprint& o)
+{
+	rows += o.rows;
+	sum += o.sum;
+	xor_sum ^= o.xor_sum;
+}
+
+ResultFingerprint
+ResultFingerprint::from_text(const std::string& text)
+{
+	ResultFingerprint r;
+	size_t begin = 0;
+
+	while (begin < text.size()) {
+		size_t end = text.find('\n', begin);
+		if (end == std::string::npos) {
+			end = text.size();
+		}
+		r.add_row(&text[begin], end - begin);
+		begin = end + 1;
+	}
+	return r;
+}
+
+#include <fstream>
+
+bool
+ResultFingerprint::from_file(ResultFingerprint& out, const std::string& path)
+{
+	std::ifstream f(path);
+	if (!f.good()) {
+		return false;
+	}
+
+	out = ResultFingerprint();
+	std::string line;
+	while (std::getline(f, line)) {
+		out.add_row(line.data(), line.size());
+	}
+	return true;
+}
+
+#include "utils.hpp"
+
+bool
+ResultFingerprint::from_file_cached(ResultFingerprint& out, const std::string& path)
+{
+	const auto file = path + ".fingerprint";
+	const auto stamp = FileUtils::get_stamp(path);
+	if (stamp.empty()) {
+		return false;
+	}
+
+	if (FileUtils::exists(file)) {
+		const auto cached = FileUtils::read_string_from_file(file);
+		const auto eol = cached.find('\n');
+		if (eol != std::string::npos && !cached.compare(0, eol, stamp) &&
+				from_string(out, cached.substr(eol+1))) {
+			return true;
+		}
+		std::cerr << "Fingerprint '" << file << "' is stale" << std::endl;
+	}
+
+	if (!from_file(out, path)) {
+		return false;
+	}
+
+	FileUtils::write_string_to_file(file, stamp + "\n" + out.to_string());
+	return true;
+}
+
+std::string
+ResultFingerprint::to_string() const
+{
+	std::ostringstream s;
+	s << rows << " " << std::hex << sum << " " << xor_sum << std::endl;
+	return s.str();
+}
+
+bool
+ResultFingerprint::from_string(ResultFingerprint& out, const std::string& str)
+{
+	std::istringstream s(str);
+	s >> out.rows >> std::hex >> out.sum >> out.xor_sum;
+	return !s.fail();
 }
 
 Query::Query(QueryConfig& cfg)
- : config(cfg)
+ : config(cfg), memory(cfg.memory_limit), next_tier(nullptr)
 {
 	primitives = new Primitives();
 	config.check_result = false;
+
+	if (config.scheduler) {
+		config.scheduler->add(*this, config.priority, config.num_threads);
+	}
 }
 
 Query::~Query()
@@ -129,6 +401,10 @@ Query::~Query()
 		delete local;
 	}
 	delete primitives;
+
+	if (config.scheduler) {
+		config.scheduler->remove(*this);
+	}
 }
 
 void
@@ -147,6 +423,8 @@ Query::reset()
 			p->reset();
 		}
 	}
+
+	memory.reset_peak();
 }
 
 #include <fstream>
@@ -159,42 +437,138 @@ Query::run_pipeline(size_t p, size_t id, bool last)
 	pipe->last = last;
 
 	// LOG_DEBUG("Pipeline %d %s\n", p, pipe->last ? "last pipeline" : "");
+	IPipeline::Scope scope(*pipe);
 	pipe->query_run();
 };
 
+void
+Query::switch_tier(size_t p)
+{
+	voila_pipeline_new_t f = next_tier;
+	if (!f || pipeline_tiers[p] == f) {
+		return;
+	}
+
+	LOG_DEBUG("Switching tier of pipeline %d\n", (int)p);
+
+	MemoryTracker::Scope scope(memory);
+
+	for (size_t t=0; t<pipelines.size(); t++) {
+		auto& pipe = pipelines[t][p];
+		delete pipe;
+		pipe = f(this, p, t);
+		ASSERT(pipe);
+	}
+	pipeline_tiers[p] = f;
+}
+
+void
+Query::set_dependencies(const std::vector<std::vector<size_t>>& deps)
+{
+	ASSERT(pipelines.size() > 0);
+	ASSERT(deps.size() == pipelines[0].size());
+
+	// a forward or cyclic dependency would deadlock _run()
+	for (size_t p=0; p<deps.size(); p++) {
+		for (auto d : deps[p]) {
+			if (d >= p) {
+				throw std::logic_error("Pipeline " + std::to_string(p) +
+					" must only depend on earlier pipelines, not on " +
+					std::to_string(d));
+			}
+		}
+	}
+	dependencies = deps;
+}
+
+int64_t
+Query::_get_param(const std::string& name) const
+{
+	auto it = config.params.find(name);
+	if (it == config.params.end()) {
+		throw std::invalid_argument("Unbound query parameter '" + name + "'");
+	}
+	return it->second;
+}
+
 void
 Query::run(size_t run_no)
+{
+	if (config.scheduler) {
+		// parallel_for and task_group in _run() use the query's arena
+		config.scheduler->run(*this, [&] () { _run(); });
+		return;
+	}
+	_run();
+}
+
+void
+Query::_run()
 {
 	ASSERT(pipelines.size() > 0);
 	size_t num_p = pipelines[0].size();
 	ASSERT(config.num_threads > 0);
 
-	
+	auto run_all_threads = [&] (size_t p) {
+		bool last = p+1 == num_p;
 
-	if (config.num_threads == 1) {
-		for (size_t p=0; p<num_p; p++) {
-			size_t id = 0;
-			bool last = p+1 == num_p;
+		switch_tier(p);
 
-			run_pipeline(p, id, last);
+		if (config.num_threads == 1) {
+			run_pipeline(p, 0, last);
+			return;
 		}
-	} else {
-		for (size_t p=0; p<num_p; p++) {
-			bool last = p+1 == num_p;
 
 #if 0
-			if (last) {
-				run_pipeline(p, 0, last);
-				continue;
-			}
+		if (last) {
+			run_pipeline(p, 0, last);
+			return;
+		}
 #endif
 
-			tbb::parallel_for<size_t>(0, config.num_threads, 1,
-				[=](size_t id) {
-					run_pipeline(p, id, last);
-				});
+		tbb::parallel_for<size_t>(0, config.num_threads, 1,
+			[=](size_t id) {
+				run_pipeline(p, id, last);
+			});
+	};
+
+	if (config.num_threads == 1 || !config.concurrent_pipelines ||
+			dependencies.empty()) {
+		for (size_t p=0; p<num_p; p++) {
+			run_all_threads(p);
 		}
+		return;
 	}
+
+	// start pipelines, once all their dependencies have finished
+	std::vector<std::atomic<size_t>> missing(num_p);
+	std::vector<std::vector<size_t>> successors(num_p);
+	for (size_t p=0; p<num_p; p++) {
+		missing[p] = dependencies[p].size();
+		for (auto d : dependencies[p]) {
+			successors[d].push_back(p);
+		}
+	}
+
+	tbb::task_group group;
+	std::function<void(size_t)> start = [&] (size_t p) {
+		group.run([&, p] () {
+			run_all_threads(p);
+
+			for (auto s : successors[p]) {
+				if (!--missing[s]) {
+					start(s);
+				}
+			}
+		});
+	};
+
+	for (size_t p=0; p<num_p; p++) {
+		if (!missing[p]) {
+			start(p);
+		}
+	}
+	group.wait();
 }
 
 IThreadLocal&
@@ -221,12 +595,28 @@ Query::check_result()
 {
 	ASSERT(config.check_result);
 
+	if (config.check_fingerprint && result.has_expected_fingerprint) {
+		const auto got = result.fingerprint();
+		if (got == result.expected_fingerprint) {
+			std::cerr << "Result are correct (fingerprint)" << std::endl;
+			return true;
+		}
+
+		std::cerr << "Fingerprint mismatch." << std::endl
+			// to_string() ends with a newline
+			<< "Expected: " << result.expected_fingerprint.to_string()
+			<< "Got     : " << got.to_string()
+			<< "Comparing rows" << std::endl;
+	}
+
 	auto gathered = result.finalize();
 	bool wrong = false;
 
 	const char newline = '\n';
 	auto gvec = split(gathered, newline);
-	auto evec = split(result.expected, newline);
+	const auto expected = result.expected_file.empty() ?
+		std::string("") : FileUtils::read_string_from_file(result.expected_file);
+	auto evec = split(expected, newline);
 
 	ASSERT(gvec.size() == result.num_rows());
 
@@ -302,6 +692,25 @@ IPipeline::~IPipeline()
 {
 }
 
+static thread_local IPipeline* g_current_pipeline = nullptr;
+
+size_t
+IPipeline::current_thread_id()
+{
+	return g_current_pipeline ? g_current_pipeline->thread_id : 0;
+}
+
+IPipeline::Scope::Scope(IPipeline& p)
+ : m_prev(g_current_pipeline)
+{
+	g_current_pipeline = &p;
+}
+
+IPipeline::Scope::~Scope()
+{
+	g_current_pipeline = m_prev;
+}
+
 void
 IPipeline::run()
 {
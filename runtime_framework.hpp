@@ -7,14 +7,22 @@
 #include <sstream>
 #include <limits>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <unordered_set>
+#include <stdexcept>
 #include "runtime_utils.hpp"
 #include "runtime.hpp"
+#include "runtime_memory.hpp"
 
 struct Query;
 struct IPipeline;
 struct IThreadLocal;
 struct Primitives;
 struct BlendSpacePoint;
+struct QueryScheduler;
+struct QuerySchedulerEntry;
 
 namespace runtime {
 	struct Database;
@@ -70,12 +78,67 @@ struct QueryConfig {
 	int timeout_seconds = 0;
 
 	std::string cxx_compiler = "g++";
+	//! Directory caching compiled queries. Empty disables the cache.
+	std::string compile_cache_dir;
+	//! Use precompiled runtime headers, if available
+	bool use_pch = true;
+	//! Compile pipelines as separate translation units in parallel
+	bool parallel_compile = true;
+	//! Start on an unoptimized build and switch to the optimized one, once compiled
+	bool tiered = false;
+	//! Run pipelines without dependencies between them concurrently
+	bool concurrent_pipelines = true;
+	//! Flush partitions per thread. More partitions balance skew better,
+	//! because idle threads take over partitions not yet claimed
+	size_t partitions_per_thread = 4;
+	//! Group-bys with at least this many estimated groups aggregate into one
+	//! table shared by all threads, instead of pre-aggregating per thread.
+	//! Requires an unfiltered input, 0 disables shared aggregation
+	size_t shared_aggr_min_groups = 0;
+	//! Place base columns and shared hash tables across NUMA nodes and
+	//! prefer scanning node-local rows
+	bool numa = true;
+	//! Check results by fingerprint first, compare rows only on mismatch
+	bool check_fingerprint = true;
+	//! Memory limit per query in bytes, 0 disables the limit
+	size_t memory_limit = 0;
+	//! Aggregation partitions are spilled to 'spill_dir', once the query
+	//! uses more than 'spill_limit' bytes. 0 disables spilling. Only flushed
+	//! partitions are spilled, hash joins and thread-local tables are not.
+	//! Must be below 'memory_limit' to have an effect
+	size_t spill_limit = 0;
+	std::string spill_dir = "/tmp";
+	//! Hash tables index rows by open addressing instead of chained bucket
+	//! heads. All of them, if 'open_addressing', otherwise only the hash
+	//! joins in 'open_addressing_joins', numbered in translation order
+	bool open_addressing = false;
+	std::unordered_set<size_t> open_addressing_joins;
+	//! Hash joins with at least this many estimated build rows partition
+	//! both sides first, then build and probe a partition at a time. Also
+	//! the hash joins in 'radix_joins'. 0 disables the estimate
+	size_t radix_join_min_build_rows = 0;
+	std::unordered_set<size_t> radix_joins;
+	//! Target size of a radix join partition, its rows plus its buckets
+	size_t radix_join_partition_bytes = 1024*1024;
+	//! Thread-local chained indexes, outgrowing their estimate, double
+	//! and split buckets over later inserts instead of rebuilding at once.
+	//! Bounds the stall per insert, but walks chains instead of rows
+	bool incremental_index_growth = false;
+	//! Shares threads with other concurrently running queries, if set
+	QueryScheduler* scheduler = nullptr;
+	//! Priority for the scheduler's threads, 0 low, 1 normal and 2 high
+	size_t priority = 1;
 	std::string write_result_to_file;
 	std::string compare_result_to_file;
 
 	std::string write_profile_to_file;
 
 	std::unordered_map<int, std::string> pipeline_default_blend;
+
+	//! Bindings of query parameters, generated code reads them via Query::get_param
+	std::unordered_map<std::string, int64_t> params;
+	//! Parameters declared by the queries, see declare_param()
+	std::unordered_set<std::string> declared_params;
 	const BlendSpacePoint* full_blend = nullptr;
 
 	//! Enables all possible blends. Even without actual args ... to count #BLENDs
@@ -91,48 +154,178 @@ EXPAND_CONFIG_ITEMS(DECL, 0)
 	QueryConfig(runtime::Database& db) : db(db) {
 	}
 
+	//! Rounded up to a power of 2, rows are partitioned on hash bits
+	size_t get_num_flush_partitions() const {
+		size_t n = 1;
+		while (n < num_threads * partitions_per_thread) {
+			n *= 2;
+		}
+		return n;
+	}
+
+	bool use_open_addressing_join(size_t join_id) const {
+		return open_addressing || open_addressing_joins.count(join_id);
+	}
+
+	bool use_radix_join(size_t join_id, size_t build_rows) const {
+		return radix_joins.count(join_id) ||
+			(radix_join_min_build_rows && build_rows >= radix_join_min_build_rows);
+	}
+
 	void write(std::ostream& o, const std::string& sep = ",");	
+
+	//! Declares query parameter 'name', bound to 'dflt' unless bound already.
+	//! Throws std::invalid_argument, if the bound value does not fit the
+	//! parameter's type, the smallest signed type holding 'dflt'
+	void declare_param(const std::string& name, int64_t dflt);
+
+	//! Throws std::invalid_argument, if a parameter is bound, but not declared
+	void check_params() const;
 };
 
 struct IResetable;
 
+//! Order-independent fingerprint of a multiset of rows
+struct ResultFingerprint {
+	uint64_t rows = 0;
+	uint64_t sum = 0;
+	uint64_t xor_sum = 0;
+
+	void add_row(const char* row, size_t len);
+	void add(const ResultFingerprint& o);
+
+	//! Fingerprint of text with one row per line
+	static ResultFingerprint from_text(const std::string& text);
+	//! Like from_text(), but streams the file instead of loading it
+	static bool from_file(ResultFingerprint& out, const std::string& path);
+	//! Like from_file(), but cached in '<path>.fingerprint' together with the
+	//! file's size and modification time. Recomputed, when these do not match
+	static bool from_file_cached(ResultFingerprint& out, const std::string& path);
+
+	std::string to_string() const;
+	static bool from_string(ResultFingerprint& out, const std::string& s);
+
+	bool operator==(const ResultFingerprint& o) const {
+		return rows == o.rows && sum == o.sum && xor_sum == o.xor_sum;
+	}
+	bool operator!=(const ResultFingerprint& o) const {
+		return !(*this == o);
+	}
+};
+
+//! Collects result rows in binary, columnar buffers, one per thread.
+//! Rows are appended without locking and only formatted in finalize()
 struct QueryResult {
+	QueryResult();
 	void reset();
 
-	std::string expected;
+	//! File with the expected rows, only read when fingerprints differ
+	std::string expected_file;
+	ResultFingerprint expected_fingerprint;
+	bool has_expected_fingerprint = false;
 private:
-	size_t colid = 0;
-	size_t rowid = 0;
+	struct Column {
+		std::vector<char> data;
+		//! Characters of varchar values, 'data' holds offset and length
+		std::vector<char> heap;
+
+		void (*format)(std::string& out, const Column& col, size_t row) = nullptr;
+	};
+
+	struct Buffer {
+		std::vector<Column> cols;
+		size_t colid = 0;
+		size_t rows = 0;
+	};
 
-	std::ostringstream gathered;
+	//! Identifies buffers of this result (and run) in the threads' caches
+	uint64_t epoch;
 
+	//! Only guards registering new buffers
 	std::mutex mutex;
+	std::vector<std::unique_ptr<Buffer>> buffers;
+
+	Buffer& get_buffer();
+
+	template<typename T>
+	static void format_col(std::string& out, const Column& col, size_t row) {
+		T val;
+		memcpy(&val, &col.data[row * sizeof(T)], sizeof(T));
+
+		size_t buffer_size = voila_cast<T>::good_buffer_size();
+		char* str; char buffer[buffer_size];
+		buffer_size = voila_cast<T>::to_cstr(str, &buffer[0], buffer_size, val);
+		out.append(str, buffer_size);
+	}
+
+	static void format_varchar(std::string& out, const Column& col, size_t row);
+
+	template<typename T>
+	static void append(Column& col, const T& val) {
+		if (!col.format) {
+			col.format = &format_col<T>;
+		}
+		ASSERT(col.format == &format_col<T> && "Column type changed");
+
+		const size_t offset = col.data.size();
+		col.data.resize(offset + sizeof(T));
+		memcpy(&col.data[offset], &val, sizeof(T));
+	}
+
+	static void append(Column& col, const varchar& val);
 
 public:
 	void begin_line();
-	void push_col(const std::string& s);
-	void push_col(const char* buf, size_t len);
+
+	template<typename T>
+	void push(const T& val) {
+		auto& buf = get_buffer();
+		if (buf.colid >= buf.cols.size()) {
+			buf.cols.resize(buf.colid+1);
+		}
+		append(buf.cols[buf.colid], val);
+		buf.colid++;
+	}
+
 	void end_line();
 
-	size_t num_rows() const {
-		return rowid;
-	} 
+	size_t num_rows();
 
 	std::string finalize();
 
+	//! Fingerprint of the formatted rows, without materializing them
+	ResultFingerprint fingerprint();
+
 private:
+	void format_row(std::string& out, const Buffer& buf, size_t row) const;
+
 	bool init = false;
 
+	//! Formatted result, empty if not yet formatted
+	std::string formatted;
+	bool is_formatted = false;
 };
 
+//! Creates pipeline 'pipeline' for thread 'thread_id', exported by the generated library
+typedef IPipeline* (*voila_pipeline_new_t)(Query* q, size_t pipeline, size_t thread_id);
+
 struct Query : IResetableList {
 	QueryConfig& config;
 	QueryResult result;
+	MemoryTracker memory;
+	//! Set while registered at 'config.scheduler'
+	QuerySchedulerEntry* scheduler_entry = nullptr;
 
 public:
 	Primitives* primitives;
 
 private:
+	//! Per thread id, an instance of each pipeline. An instance runs as
+	//! one task until the morsels are gone, on whichever worker is free.
+	//! With fewer workers than 'num_threads', the remaining instances start
+	//! later and find fewer or no morsels. Instances cannot be suspended
+	//! between morsels: They keep thread-local tables, claimed partitions
+	//! and FSM states holding rows of earlier morsels
 	std::vector<std::vector<IPipeline*>> pipelines;
 
 	std::vector<IThreadLocal*> locals;
@@ -141,9 +334,43 @@ private:
 	IThreadLocal& _get_thread_local(IPipeline& p);
 
 	void run_pipeline(size_t p, size_t id, bool last);
+
+	std::atomic<voila_pipeline_new_t> next_tier;
+	//! Library that created each pipeline, nullptr for the initial one
+	std::vector<voila_pipeline_new_t> pipeline_tiers;
+
+	void switch_tier(size_t p);
+
+	//! Earlier pipelines, each pipeline waits for. Empty runs all in order
+	std::vector<std::vector<size_t>> dependencies;
+
+	int64_t _get_param(const std::string& name) const;
+
+	void _run();
 public:
 	void run(size_t run_no);
 
+	//! Pipelines without a dependency path between them may run concurrently
+	void set_dependencies(const std::vector<std::vector<size_t>>& deps);
+
+	//! Replaces each pipeline, before it starts next time
+	void tier_up(voila_pipeline_new_t f) {
+		next_tier = f;
+	}
+
+	//! Value bound to query parameter 'name'. Throws std::out_of_range, if
+	//! it does not fit into T
+	template<typename T> T
+	get_param(const std::string& name) const {
+		const int64_t v = _get_param(name);
+		if (v < (int64_t)std::numeric_limits<T>::min() ||
+				v > (int64_t)std::numeric_limits<T>::max()) {
+			throw std::out_of_range("Query parameter '" + name +
+				"' out of range of its type");
+		}
+		return v;
+	}
+
 	bool check_result();
 	void print_result();
 	void write_result_to_file(const std::string& fname);
@@ -155,12 +382,16 @@ public:
 
 
 	template<typename S, typename T>void init(const S& f, const T& m) {
+		// attribute vectors of the pipelines to this query
+		MemoryTracker::Scope scope(memory);
+
 		for (size_t t=0; t<config.num_threads; t++) {
 			locals.push_back(m(t, config.num_threads));
 		}
 		for (size_t t=0; t<config.num_threads; t++) {
 			pipelines.push_back(f(t, config.num_threads));
 		}
+		pipeline_tiers.resize(pipelines[0].size(), nullptr);
 	}
 
 	void reset() override;
@@ -178,6 +409,18 @@ struct IPipeline : IResetableList {
 
 	bool last;
 
+	//! 'thread_id' of the pipeline the calling thread runs, 0 outside of pipelines
+	static size_t current_thread_id();
+
+	//! Makes 'p' the thread's current pipeline while in scope
+	struct Scope {
+		Scope(IPipeline& p);
+		~Scope();
+
+	private:
+		IPipeline* m_prev;
+	};
+
 	virtual void run();
 
 	virtual void post_run() {
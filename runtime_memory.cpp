@@ -2,12 +2,26 @@
 #include "runtime.hpp"
 #include "build.hpp"
 
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+
 #define HAVE_LINUX_MREMAP
 
 #ifdef HAVE_POSIX_SYSCONF
 #include <unistd.h>
 #endif
 
+#ifdef HAVE_LINUX_MBIND
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <dirent.h>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <algorithm>
+#endif
+
 static size_t
 get_page_size()
 {
@@ -52,13 +66,92 @@ malloc_dealloc(void *p, size_t alloc_size)
 	::free(p);
 }
 
+static HugePages::Policy g_huge_policy = HugePages::Policy::Transparent;
+static size_t g_huge_min_block_bytes = HugePages::kDefaultMinBlockBytes;
+static std::atomic<size_t> g_huge_mapped_bytes(0);
+
+void
+HugePages::set_policy(Policy p, size_t min_block_bytes)
+{
+	g_huge_policy = p;
+	g_huge_min_block_bytes = min_block_bytes;
+}
+
+HugePages::Policy
+HugePages::get_policy()
+{
+	return g_huge_policy;
+}
+
+bool
+HugePages::applies(size_t size, bool block)
+{
+	if (g_huge_policy == Policy::None || size < kPageSize) {
+		return false;
+	}
+	return !block || size >= g_huge_min_block_bytes;
+}
+
+size_t
+HugePages::get_mapped_bytes()
+{
+	return g_huge_mapped_bytes;
+}
+
 #ifdef HAVE_POSIX_MMAP
 #include <sys/mman.h>
 #include <fcntl.h>
 
+//! Anonymous mapping with huge pages, rounded to the huge page size.
+//! Not populated, the pages are faulted in by the first touch
+static bool
+mmap_huge_allocex(size_t alloc_size, size_t *out_size, void **out)
+{
+	const size_t page_size = HugePages::kPageSize;
+	const size_t fixed_size = (alloc_size + page_size - 1) / page_size * page_size;
+	void* p = MAP_FAILED;
+
+#ifdef HAVE_LINUX_MAP_HUGETLB
+	if (g_huge_policy == HugePages::Policy::Explicit) {
+		p = mmap(0, fixed_size, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if (p == MAP_FAILED) {
+			LOG_DEBUG("MAP_HUGETLB(%lld) failed %s, using transparent huge pages\n",
+				(long long)fixed_size, strerror(errno));
+		}
+	}
+#endif
+
+#ifdef HAVE_LINUX_MADV_HUGEPAGE
+	if (p == MAP_FAILED) {
+		p = mmap(0, fixed_size, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (p != MAP_FAILED && madvise(p, fixed_size, MADV_HUGEPAGE)) {
+			LOG_DEBUG("madvise(MADV_HUGEPAGE) failed %s\n", strerror(errno));
+		}
+	}
+#endif
+
+	if (p == MAP_FAILED) {
+		return false;
+	}
+
+	g_huge_mapped_bytes += fixed_size;
+	*out_size = fixed_size;
+	*out = p;
+	return true;
+}
+
+static void
+mmap_huge_dealloc(void* p, size_t size)
+{
+	munmap(p, size);
+	g_huge_mapped_bytes -= size;
+}
+
 static bool
 mmap_allocex(size_t alloc_size, size_t page_size, size_t *out_size,
-	void **out)
+	void **out, bool populate = true)
 {
 	void *p;
 	int fd;
@@ -68,7 +161,11 @@ mmap_allocex(size_t alloc_size, size_t page_size, size_t *out_size,
 	fixed_size = (alloc_size + page_size - 1) / page_size * page_size;
 
 #ifdef HAVE_LINUX_MAP_POPULATE
-	flags |= MAP_POPULATE;
+	if (populate) {
+		flags |= MAP_POPULATE;
+	}
+#else
+	(void)populate;
 #endif
 
 	fd = open("/dev/zero", O_RDWR);
@@ -128,11 +225,29 @@ mmap_reallocex(size_t page_size, void *old_ptr, size_t old_size,
 #else
 static bool
 mmap_allocex(size_t alloc_size, size_t page_size, size_t *out_size,
-	void **out)
+	void **out, bool populate = true)
 {
+	(void)populate;
 	return malloc_allocex(alloc_size, page_size, out_size, out);
 }
 
+static bool
+mmap_huge_allocex(size_t alloc_size, size_t *out_size, void **out)
+{
+	(void)alloc_size;
+	(void)out_size;
+	(void)out;
+	return false;
+}
+
+static void
+mmap_huge_dealloc(void* p, size_t size)
+{
+	(void)p;
+	(void)size;
+	ASSERT(false && "No huge page support");
+}
+
 static bool
 mmap_reallocex(size_t page_size, void *old_ptr, size_t old_size,
 	size_t new_size, size_t *out_size, void **out_ptr)
@@ -149,22 +264,281 @@ mmap_dealloc(void *p, size_t alloc_size)
 #endif
 
 
-LargeBuffer::LargeBuffer()
+#include <map>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+//! Free lists by kind of allocation, size and NUMA node
+struct FreeLists {
+	enum Kind {
+		kMalloc = 0,
+		kMmap,
+		kMmapInterleaved,
+		//! Huge page mappings for blocks, keyed by requested size
+		kBlockHuge,
+		kNumKinds
+	};
+
+	struct Chunk {
+		void* data;
+		size_t dirty;
+	};
+
+	//! Size and NUMA node
+	typedef std::pair<size_t, size_t> Key;
+
+	std::mutex mutex;
+	std::map<Key, std::vector<Chunk>> lists[kNumKinds];
+	//! Written under 'mutex', read without
+	std::atomic<size_t> cached { 0 };
+	size_t limit = (size_t)4 * 1024 * 1024 * 1024;
+
+	//! Mapped size of huge page mappings
+	std::unordered_map<void*, size_t> huge;
+
+	bool get(Chunk& out, Kind kind, size_t size, size_t node) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = lists[kind].find(Key(size, node));
+		if (it == lists[kind].end() || it->second.empty()) {
+			return false;
+		}
+		out = it->second.back();
+		it->second.pop_back();
+		cached -= size;
+		return true;
+	}
+
+	bool put(Kind kind, void* data, size_t size, size_t dirty, size_t node) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (cached + size > limit) {
+			return false;
+		}
+		lists[kind][Key(size, node)].push_back(Chunk { data, dirty });
+		cached += size;
+		return true;
+	}
+
+	void add_huge(void* data, size_t mapped_size) {
+		std::lock_guard<std::mutex> lock(mutex);
+		huge[data] = mapped_size;
+	}
+
+	//! Mapped size, if 'data' is a huge page mapping, otherwise 0
+	size_t get_huge(void* data) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = huge.find(data);
+		return it == huge.end() ? 0 : it->second;
+	}
+
+	void dealloc(Kind kind, void* data, size_t size) {
+		if (kind == kMalloc) {
+			::free(data);
+			return;
+		}
+
+		size_t huge_size;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = huge.find(data);
+			huge_size = it == huge.end() ? 0 : it->second;
+			if (huge_size) {
+				huge.erase(it);
+			}
+		}
+
+		if (huge_size) {
+			mmap_huge_dealloc(data, huge_size);
+		} else {
+			mmap_dealloc(data, size);
+		}
+	}
+
+	void clear() {
+		shrink(std::numeric_limits<size_t>::max());
+	}
+
+	//! Releases cached chunks of at least 'bytes' bytes, the largest of
+	//! each kind first
+	void shrink(size_t bytes) {
+		std::vector<std::pair<Kind, std::pair<void*, size_t>>> chunks;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			size_t freed = 0;
+			for (size_t k=0; k<kNumKinds && freed < bytes; k++) {
+				auto& list = lists[k];
+				while (!list.empty() && freed < bytes) {
+					auto last = std::prev(list.end());
+					auto& kv = *last;
+					while (!kv.second.empty() && freed < bytes) {
+						chunks.push_back({ (Kind)k, { kv.second.back().data, kv.first.first } });
+						kv.second.pop_back();
+						freed += kv.first.first;
+					}
+					if (kv.second.empty()) {
+						list.erase(last);
+					}
+				}
+			}
+			cached -= freed;
+		}
+
+		for (auto& c : chunks) {
+			dealloc(c.first, c.second.first, c.second.second);
+		}
+	}
+};
+
+FreeLists g_free_lists;
+
+} /* anonymous namespace */
+
+size_t
+MemoryPool::size_class(size_t size)
+{
+	const size_t kMinSize = 64;
+	if (size <= kMinSize) {
+		return kMinSize;
+	}
+
+	// 4 steps between 2^k and 2^(k+1)
+	const size_t step = (1ull << (63 - __builtin_clzll(size - 1))) / 4;
+	return (size + step - 1) / step * step;
+}
+
+void*
+MemoryPool::alloc_zeroed(size_t size, size_t node)
+{
+	size = size_class(size);
+
+	const bool huge = HugePages::applies(size, true);
+	const auto kind = huge ? FreeLists::kBlockHuge : FreeLists::kMalloc;
+
+	FreeLists::Chunk chunk;
+	if (g_free_lists.get(chunk, kind, size, node)) {
+		// lazily clear, what the previous owner wrote
+		memset(chunk.data, 0, chunk.dirty);
+		return chunk.data;
+	}
+
+	if (huge) {
+		void* data;
+		size_t mapped_size;
+		if (mmap_huge_allocex(size, &mapped_size, &data)) {
+			g_free_lists.add_huge(data, mapped_size);
+			return data;
+		}
+	}
+	return calloc(1, size);
+}
+
+void
+MemoryPool::free(void* data, size_t size, size_t dirty, size_t node)
+{
+	if (!data) {
+		return;
+	}
+	size = size_class(size);
+	ASSERT(dirty <= size);
+
+	const auto kind = g_free_lists.get_huge(data) ?
+		FreeLists::kBlockHuge : FreeLists::kMalloc;
+	if (!g_free_lists.put(kind, data, size, dirty, node)) {
+		g_free_lists.dealloc(kind, data, size);
+	}
+}
+
+void
+MemoryPool::set_limit(size_t bytes)
+{
+	g_free_lists.limit = bytes;
+}
+
+void
+MemoryPool::clear()
+{
+	g_free_lists.clear();
+}
+
+size_t
+MemoryPool::get_cached_bytes()
+{
+	return g_free_lists.cached;
+}
+
+void
+MemoryPool::shrink(size_t bytes)
+{
+	g_free_lists.shrink(bytes);
+}
+
+LargeBuffer::LargeBuffer(MemoryAccount* account)
 {
 	_size = 0;
 	_data = nullptr;
 	_page_size = get_page_size();
+	_interleaved = false;
+	_node = 0;
+	_account = account;
+	_charged = 0;
 	reset();
 }
 
 void
-LargeBuffer::alloc(size_t size)
+LargeBuffer::alloc(size_t size, bool interleave)
 {
 	ASSERT(!_size && !_data);
+
+	if (_account) {
+		ASSERT(!_charged);
+		_account->charge(size);
+		_charged = size;
+	}
+
+	interleave &= Numa::num_nodes() > 1;
+	_interleaved = interleave;
+	_node = interleave ? 0 : Numa::current_node();
+
+	const auto kind = interleave ?
+		FreeLists::kMmapInterleaved : FreeLists::kMmap;
+	const bool huge = HugePages::applies(size, false);
+	const size_t page_size = huge ? HugePages::kPageSize : _page_size;
+	const size_t fixed_size = (size + page_size - 1) / page_size * page_size;
+
+	FreeLists::Chunk chunk;
+	if (g_free_lists.get(chunk, kind, fixed_size, _node)) {
+		// hash indices are written all over, reset() clears everything
+		_data = chunk.data;
+		_size = fixed_size;
+		reset();
+		return;
+	}
+
 	_size = size;
 
-	bool r = mmap_allocex(_size, _page_size, &_size, &_data);
+	bool r = false;
+	if (huge) {
+		r = mmap_huge_allocex(_size, &_size, &_data);
+		if (r) {
+			g_free_lists.add_huge(_data, _size);
+		}
+	}
+	if (!r) {
+		r = mmap_allocex(_size, _page_size, &_size, &_data,
+			!interleave && !huge);
+	}
 	ASSERT(r);
+
+	if (interleave) {
+		// set policy before reset() touches the pages
+		Numa::interleave(_data, _size);
+	}
 	reset();
 }
 
@@ -172,8 +546,19 @@ void
 LargeBuffer::free()
 {
 	if (_data) {
-		mmap_dealloc(_data, _size);
+		const auto kind = _interleaved ?
+			FreeLists::kMmapInterleaved : FreeLists::kMmap;
+		const size_t fixed_size = (_size + _page_size - 1) / _page_size * _page_size;
+
+		if (_size != fixed_size ||
+				!g_free_lists.put(kind, _data, _size, _size, _node)) {
+			g_free_lists.dealloc(kind, _data, _size);
+		}
+	}
+	if (_account) {
+		_account->release(_charged);
 	}
+	_charged = 0;
 	_data = nullptr;
 	_size = 0;
 }
@@ -186,6 +571,15 @@ LargeBuffer::~LargeBuffer()
 void
 LargeBuffer::resize(size_t newsz)
 {
+	if (_account) {
+		if (newsz > _charged) {
+			_account->charge(newsz - _charged);
+		} else {
+			_account->release(_charged - newsz);
+		}
+		_charged = newsz;
+	}
+
 	bool r = mmap_reallocex(_page_size, _data, _size, newsz,
 		&_size, &_data);
 	ASSERT(r);
@@ -198,4 +592,309 @@ LargeBuffer::reset()
 	if (_data) {
 		memset(_data, 0, _size);
 	}
-}
\ No newline at end of file
+}
+
+
+
+#ifdef HAVE_LINUX_MBIND
+static std::vector<size_t>
+read_numa_node_ids()
+{
+	std::vector<size_t> ids;
+
+	// ranges of online nodes, like "0-1,4"
+	if (FILE* f = fopen("/sys/devices/system/node/online", "r")) {
+		char buf[4096];
+		const char* p = fgets(buf, sizeof(buf), f);
+		fclose(f);
+
+		while (p && isdigit(*p)) {
+			char* end;
+			const size_t lo = strtoul(p, &end, 10);
+			size_t hi = lo;
+			if (*end == '-') {
+				hi = strtoul(end + 1, &end, 10);
+			}
+			for (size_t n=lo; n<=hi; n++) {
+				ids.push_back(n);
+			}
+			p = *end == ',' ? end + 1 : nullptr;
+		}
+	}
+
+	if (ids.empty()) {
+		if (DIR* dir = opendir("/sys/devices/system/node")) {
+			while (struct dirent* e = readdir(dir)) {
+				if (!strncmp(e->d_name, "node", 4) && isdigit(e->d_name[4])) {
+					ids.push_back(strtoul(e->d_name + 4, nullptr, 10));
+				}
+			}
+			closedir(dir);
+		}
+		std::sort(ids.begin(), ids.end());
+	}
+
+	if (ids.empty()) {
+		ids.push_back(0);
+	}
+	return ids;
+}
+
+//! IDs of the online NUMA nodes, ascending. They can be sparse, Numa
+//! numbers the nodes by their position in here
+static const std::vector<size_t>&
+numa_node_ids()
+{
+	static const std::vector<size_t> ids = read_numa_node_ids();
+	return ids;
+}
+
+static void
+numa_mbind(void* data, size_t size, int mode, size_t first_node, size_t num_nodes)
+{
+	static const size_t page_size = get_page_size();
+
+	// only whole pages inside the range
+	const uintptr_t begin = ((uintptr_t)data + page_size - 1) / page_size * page_size;
+	const uintptr_t end = ((uintptr_t)data + size) / page_size * page_size;
+	if (begin >= end) {
+		return;
+	}
+
+	const auto& ids = numa_node_ids();
+	ASSERT(first_node + num_nodes <= ids.size());
+
+	const size_t bits = 8*sizeof(unsigned long);
+	std::vector<unsigned long> mask(ids.back() / bits + 1, 0);
+	for (size_t n=first_node; n<first_node+num_nodes; n++) {
+		mask[ids[n] / bits] |= 1ul << (ids[n] % bits);
+	}
+
+	long r = syscall(SYS_mbind, begin, end - begin, mode, &mask[0],
+		mask.size()*bits + 1, MPOL_MF_MOVE);
+	if (r) {
+		// placement is only a hint, but should not silently go missing
+		static std::atomic<bool> warned(false);
+		if (!warned.exchange(true)) {
+			fprintf(stderr, "Warning: mbind(%p, %lld) failed: %s. "
+				"NUMA placement is not applied\n", (void*)begin,
+				(long long)(end - begin), strerror(errno));
+		}
+	}
+}
+#endif
+
+size_t
+Numa::num_nodes()
+{
+#ifdef HAVE_LINUX_MBIND
+	return numa_node_ids().size();
+#else
+	return 1;
+#endif
+}
+
+size_t
+Numa::current_node()
+{
+#ifdef HAVE_LINUX_MBIND
+	unsigned cpu, node;
+	if (syscall(SYS_getcpu, &cpu, &node, nullptr)) {
+		return 0;
+	}
+
+	const auto& ids = numa_node_ids();
+	auto it = std::lower_bound(ids.begin(), ids.end(), (size_t)node);
+	return it != ids.end() && *it == node ? it - ids.begin() : 0;
+#else
+	return 0;
+#endif
+}
+
+void
+Numa::interleave(void* data, size_t size)
+{
+#ifdef HAVE_LINUX_MBIND
+	if (num_nodes() > 1) {
+		numa_mbind(data, size, MPOL_INTERLEAVE, 0, num_nodes());
+	}
+#else
+	(void)data;
+	(void)size;
+#endif
+}
+
+void
+Numa::bind(void* data, size_t size, size_t node)
+{
+#ifdef HAVE_LINUX_MBIND
+	if (num_nodes() > 1) {
+		numa_mbind(data, size, MPOL_BIND, node, 1);
+	}
+#else
+	(void)data;
+	(void)size;
+	(void)node;
+#endif
+}
+
+
+
+MemoryAccount::MemoryAccount(MemoryTracker* tracker, const std::string& name)
+ : name(name), m_tracker(tracker), m_current(0), m_peak(0)
+{
+	if (m_tracker) {
+		m_tracker->add(this);
+	}
+}
+
+MemoryAccount::~MemoryAccount()
+{
+	if (m_tracker) {
+		m_tracker->remove(this);
+	}
+}
+
+static void
+update_peak(std::atomic<size_t>& peak, size_t value)
+{
+	size_t old = peak.load();
+	while (value > old && !peak.compare_exchange_weak(old, value)) {
+	}
+}
+
+void
+MemoryAccount::charge(size_t bytes)
+{
+	if (m_tracker) {
+		m_tracker->charge(bytes, *this);
+	}
+	update_peak(m_peak, m_current += bytes);
+}
+
+void
+MemoryAccount::release(size_t bytes)
+{
+	ASSERT(m_current >= bytes);
+	m_current -= bytes;
+	if (m_tracker) {
+		m_tracker->release(bytes);
+	}
+}
+
+MemoryTracker::MemoryTracker(size_t limit)
+ : m_limit(limit), m_current(0), m_peak(0), m_unattributed(this, "vectors")
+{
+}
+
+MemoryTracker::~MemoryTracker()
+{
+}
+
+void
+MemoryTracker::add(MemoryAccount* a)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_accounts.push_back(a);
+}
+
+void
+MemoryTracker::remove(MemoryAccount* a)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_accounts.erase(std::remove(m_accounts.begin(), m_accounts.end(), a),
+		m_accounts.end());
+}
+
+void
+MemoryTracker::charge(size_t bytes, const MemoryAccount& a)
+{
+	const size_t now = m_current += bytes;
+	if (!m_limit) {
+		update_peak(m_peak, now);
+		return;
+	}
+
+	// memory cached for reuse counts against the limit as well, give
+	// it back before the query runs out
+	const size_t cached = MemoryPool::get_cached_bytes();
+	if (now + cached > m_limit) {
+		MemoryPool::shrink(now + cached - m_limit);
+	}
+
+	if (now > m_limit) {
+		m_current -= bytes;
+		throw MemoryLimitExceeded("Memory limit of " + std::to_string(m_limit) +
+			" bytes exceeded by '" + a.name + "', allocating " +
+			std::to_string(bytes) + " bytes with " +
+			std::to_string(now - bytes) + " bytes in use");
+	}
+	update_peak(m_peak, now);
+}
+
+void
+MemoryTracker::release(size_t bytes)
+{
+	ASSERT(m_current >= bytes);
+	m_current -= bytes;
+}
+
+void
+MemoryTracker::reset_peak()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_peak = m_current.load();
+	for (auto a : m_accounts) {
+		a->reset_peak();
+	}
+}
+
+#include <iostream>
+#include <iomanip>
+
+void
+MemoryTracker::print(std::ostream& o)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<MemoryAccount*> accounts(m_accounts);
+	std::sort(accounts.begin(), accounts.end(), [] (auto a, auto b) {
+		return a->peak() > b->peak();
+	});
+
+	const double mib = 1024.0 * 1024.0;
+	o << "Memory peak " << std::fixed << std::setprecision(1)
+		<< (m_peak / mib) << " MiB, current " << (m_current / mib) << " MiB";
+	if (m_limit) {
+		o << ", limit " << (m_limit / mib) << " MiB";
+	}
+	o << std::endl;
+
+	for (auto a : accounts) {
+		if (!a->peak()) {
+			continue;
+		}
+		o << "  " << a->name << ": peak " << (a->peak() / mib)
+			<< " MiB, current " << (a->current() / mib) << " MiB" << std::endl;
+	}
+	o << std::defaultfloat;
+}
+
+static thread_local MemoryTracker* g_current_tracker = nullptr;
+
+MemoryAccount*
+MemoryTracker::current_unattributed()
+{
+	return g_current_tracker ? &g_current_tracker->m_unattributed : nullptr;
+}
+
+MemoryTracker::Scope::Scope(MemoryTracker& t)
+ : m_prev(g_current_tracker)
+{
+	g_current_tracker = &t;
+}
+
+MemoryTracker::Scope::~Scope()
+{
+	g_current_tracker = m_prev;
+}
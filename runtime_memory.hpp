@@ -2,11 +2,171 @@
 #define H_RUNTIME_MEMORY
 
 #include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <new>
+#include <iosfwd>
+
+struct MemoryTracker;
+
+//! Thrown, when a query exceeds its memory limit
+struct MemoryLimitExceeded : std::bad_alloc {
+	MemoryLimitExceeded(const std::string& what) : msg(what) {}
+
+	const char* what() const noexcept override {
+		return msg.c_str();
+	}
+
+private:
+	const std::string msg;
+};
+
+//! Memory used by one data structure
+struct MemoryAccount {
+	const std::string name;
+
+	MemoryAccount(MemoryTracker* tracker, const std::string& name);
+	~MemoryAccount();
+
+	//! Throws MemoryLimitExceeded, if the query would exceed its limit
+	void charge(size_t bytes);
+	void release(size_t bytes);
+
+	size_t current() const { return m_current; }
+	size_t peak() const { return m_peak; }
+
+	void reset_peak() { m_peak = m_current.load(); }
+
+private:
+	MemoryTracker* m_tracker;
+	std::atomic<size_t> m_current;
+	std::atomic<size_t> m_peak;
+};
+
+//! Memory accounting of one query, optionally enforcing a limit.
+//! Memory cached by MemoryPool counts against the limit, the pool shrinks,
+//! as soon as both together would exceed it
+struct MemoryTracker {
+	//! No limit, if 0
+	MemoryTracker(size_t limit = 0);
+	~MemoryTracker();
+
+	size_t current() const { return m_current; }
+	size_t peak() const { return m_peak; }
+	size_t limit() const { return m_limit; }
+
+	void reset_peak();
+
+	//! Peak and current usage per data structure
+	void print(std::ostream& o);
+
+	//! Account for allocations of the thread's current query, which
+	//! cannot name their data structure, like vectors. Can be nullptr
+	static MemoryAccount* current_unattributed();
+
+	//! Makes 't' the thread's current query while in scope
+	struct Scope {
+		Scope(MemoryTracker& t);
+		~Scope();
+
+	private:
+		MemoryTracker* m_prev;
+	};
+
+private:
+	friend struct MemoryAccount;
+
+	void add(MemoryAccount* a);
+	void remove(MemoryAccount* a);
+	void charge(size_t bytes, const MemoryAccount& a);
+	void release(size_t bytes);
+
+	const size_t m_limit;
+	std::atomic<size_t> m_current;
+	std::atomic<size_t> m_peak;
+
+	std::mutex m_mutex;
+	std::vector<MemoryAccount*> m_accounts;
+
+	MemoryAccount m_unattributed;
+};
+
+//! Best-effort NUMA placement. Without NUMA support there is one node.
+//! Nodes are numbered 0..num_nodes()-1 in the order of their IDs, which
+//! can be sparse
+struct Numa {
+	static size_t num_nodes();
+
+	//! Node of the CPU, the calling thread is running on
+	static size_t current_node();
+
+	//! Spreads pages of the given range round-robin over all nodes
+	static void interleave(void* data, size_t size);
+
+	//! Moves pages of the given range to 'node'
+	static void bind(void* data, size_t size, size_t node);
+};
+
+//! Backing of large allocations (hash indices and big blocks) by huge pages
+struct HugePages {
+	enum Policy {
+		None,
+		//! madvise(MADV_HUGEPAGE), transparent huge pages
+		Transparent,
+		//! MAP_HUGETLB from the reserved pool, falls back to Transparent
+		Explicit
+	};
+
+	static constexpr size_t kPageSize = 2*1024*1024;
+	static constexpr size_t kDefaultMinBlockBytes = 64*1024*1024;
+
+	//! Blocks are only backed by huge pages from 'min_block_bytes' on.
+	//! Process-wide, hence set once at startup and not per query. Defaults
+	//! to Transparent
+	static void set_policy(Policy p, size_t min_block_bytes);
+	static Policy get_policy();
+
+	//! Whether an allocation of 'size' bytes should use huge pages
+	static bool applies(size_t size, bool block);
+
+	//! Bytes currently mapped with huge pages
+	static size_t get_mapped_bytes();
+};
+
+//! Process-wide cache of freed memory, reused by size class and NUMA
+//! node. Saves the page faults and zeroing of fresh memory across runs
+//! and queries
+struct MemoryPool {
+	//! Zeroed memory of size_class(size) bytes, recycled from 'node' or
+	//! from calloc()
+	static void* alloc_zeroed(size_t size, size_t node);
+
+	//! Only the first 'dirty' bytes may have been written. 'size' and
+	//! 'node' as passed to alloc_zeroed()
+	static void free(void* data, size_t size, size_t dirty, size_t node);
+
+	//! Rounds up to one of 4 classes per power of 2, wasting at most 25%
+	static size_t size_class(size_t size);
+
+	//! Upper bound for cached memory, in bytes
+	static void set_limit(size_t bytes);
+
+	//! Releases all cached memory
+	static void clear();
+
+	//! Releases at least 'bytes' of cached memory, if cached
+	static void shrink(size_t bytes);
+
+	static size_t get_cached_bytes();
+};
 
 struct LargeBuffer {
-	LargeBuffer();
+	LargeBuffer(MemoryAccount* account = nullptr);
 
-	void alloc(size_t size);
+	//! 'interleave' spreads the buffer over all NUMA nodes, otherwise it
+	//! lives on the node of the calling thread
+	void alloc(size_t size, bool interleave = false);
 	void free();
 
 	~LargeBuffer();
@@ -26,6 +186,11 @@ private:
 	void* _data;
 	size_t _size;
 	size_t _page_size;
+	bool _interleaved;
+	//! NUMA node, the buffer was allocated on
+	size_t _node;
+	MemoryAccount* _account;
+	size_t _charged;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef H_RUNTIME_PCH
+#define H_RUNTIME_PCH
+
+/* Umbrella header for the precompiled header used when compiling
+ * generated queries (see target runtime_pch and Compiler::call_cxx_compiler).
+ * Mirrors the includes emitted by Codegen. */
+
+#include "runtime.hpp"
+#include "runtime_vector.hpp"
+#include "runtime_struct.hpp"
+#include "runtime_hyper.hpp"
+#include "runtime_simd.hpp"
+#include "runtime_translation.hpp"
+#include "runtime_framework.hpp"
+#include "runtime_buffering.hpp"
+
+#include "kernels1.hpp"
+#include "kernels2.hpp"
+#include "kernels3.hpp"
+#include "kernels4.hpp"
+#include "kernels5.hpp"
+#include "kernels6.hpp"
+#include "kernels7.hpp"
+#include "kernels8.hpp"
+#include "kernels9.hpp"
+#include "kernels10.hpp"
+#include "kernels11.hpp"
+#include "kernels12.hpp"
+#include "kernels13.hpp"
+#include "kernels14.hpp"
+#include "kernels15.hpp"
+#include "kernels16.hpp"
+#include "kernels17.hpp"
+#include "kernels18.hpp"
+#include "kernels19.hpp"
+#include "kernels20.hpp"
+#include "kernels21.hpp"
+#include "kernels22.hpp"
+#include "kernels23.hpp"
+#include "kernels24.hpp"
+#include "kernels25.hpp"
+#include "kernels26.hpp"
+#include "kernels27.hpp"
+#include "kernels28.hpp"
+#include "kernels29.hpp"
+#include "kernels30.hpp"
+#include "kernels31.hpp"
+#include "kernels32.hpp"
+
+#include <string>
+#include <iostream>
+#include <memory>
+
+#endif
\ No newline at end of file
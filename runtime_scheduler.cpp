@@ -0,0 +1,128 @@
+#include "runtime_scheduler.hpp"
+#include "runtime_framework.hpp"
+#include <algorithm>
+#include <tbb/task.h>
+
+QueryScheduler::QueryScheduler(size_t num_slots)
+ : num_slots(num_slots)
+{
+	ASSERT(num_slots > 0);
+
+	// counts one thread outside of the pool, i.e. 'num_slots' workers
+	parallelism = std::make_unique<tbb::global_control>(
+		tbb::global_control::max_allowed_parallelism, num_slots + 1);
+}
+
+QueryScheduler::~QueryScheduler()
+{
+	ASSERT(entries.empty());
+}
+
+void
+QueryScheduler::add(Query& q, size_t priority, size_t max_threads)
+{
+	ASSERT(max_threads > 0);
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// no slot is reserved for the thread calling run(). It competes with
+	// the workers for the arena's slots
+	auto& e = entries[&q];
+	ASSERT(!e && "Query already registered");
+	e.reset(new QuerySchedulerEntry());
+	e->arena = std::make_unique<tbb::task_arena>(
+		(int)std::min(max_threads, num_slots), 0);
+	e->priority = priority;
+	q.scheduler_entry = e.get();
+}
+
+void
+QueryScheduler::remove(Query& q)
+{
+	std::unique_ptr<QuerySchedulerEntry> entry;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = entries.find(&q);
+		ASSERT(it != entries.end() && "Query not registered");
+		entry = std::move(it->second);
+		entries.erase(it);
+		q.scheduler_entry = nullptr;
+	}
+	// waits for the arena's workers to leave, not under the lock
+}
+
+#if __TBB_TASK_PRIORITY
+static tbb::priority_t
+context_priority(size_t priority)
+{
+	switch (priority) {
+	case 0:		return tbb::priority_low;
+	case 1:		return tbb::priority_normal;
+	default:	return tbb::priority_high;
+	}
+}
+#endif
+
+void
+QueryScheduler::run(Query& q, const std::function<void()>& f)
+{
+	QuerySchedulerEntry* e;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		e = &get_entry(q);
+		e->morsels = 0;
+		e->tuples = 0;
+		e->latency_ms = 0.0;
+		e->start = clock::now();
+	}
+
+	e->arena->execute([&] () {
+#if __TBB_TASK_PRIORITY
+		// tasks spawned by 'f' bind to the arena's context and inherit
+		// its priority
+		tbb::task::self().group()->set_priority(context_priority(e->priority));
+#endif
+		f();
+	});
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	e->latency_ms = std::chrono::duration<double, std::milli>(
+		clock::now() - e->start).count();
+}
+
+void
+QueryScheduler::next_morsel(IPipeline& p, int64_t num)
+{
+	if (num < 0) {
+		return;
+	}
+
+	// registered for the query's lifetime, no lookup under the lock
+	auto e = p.query.scheduler_entry;
+	ASSERT(e && "Query not registered");
+	e->morsels.fetch_add(1, std::memory_order_relaxed);
+	e->tuples.fetch_add(num, std::memory_order_relaxed);
+}
+
+QueryScheduler::Stats
+QueryScheduler::get_stats(Query& q)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& e = get_entry(q);
+
+	Stats stats;
+	stats.latency_ms = e.latency_ms;
+	stats.morsels = e.morsels;
+	stats.tuples = e.tuples;
+	return stats;
+}
+
+QuerySchedulerEntry&
+QueryScheduler::get_entry(Query& q)
+{
+	auto it = entries.find(&q);
+	ASSERT(it != entries.end() && "Query not registered");
+	return *it->second;
+}
@@ -0,0 +1,89 @@
+#ifndef H_RUNTIME_SCHEDULER
+#define H_RUNTIME_SCHEDULER
+
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <chrono>
+
+#include <atomic>
+
+#include <tbb/task_arena.h>
+#include <tbb/global_control.h>
+
+struct Query;
+struct IPipeline;
+
+//! State of one query registered at the QueryScheduler, referenced by
+//! Query::scheduler_entry
+struct QuerySchedulerEntry {
+	typedef std::chrono::high_resolution_clock clock;
+
+	std::unique_ptr<tbb::task_arena> arena;
+	size_t priority = 0;
+
+	clock::time_point start;
+	double latency_ms = 0.0;
+
+	//! Updated by every morsel of every thread, hence not under the lock
+	std::atomic<size_t> morsels;
+	std::atomic<size_t> tuples;
+
+	QuerySchedulerEntry() : morsels(0), tuples(0) {}
+};
+
+//! Shares one TBB worker pool of 'num_slots' threads between concurrently
+//! running queries. Each query runs in its own task arena, which bounds its
+//! threads and carries its priority. Idle workers join any arena with
+//! pending tasks, higher priorities first. Nobody blocks for a slot, so
+//! workers are never parked inside another query's parallel_for.
+//! Uses the legacy TBB API (task_scheduler_init era, 2019 or later), like
+//! the rest of the tree.
+//! All morsel sources, IBaseTable::get_scan_morsel() and
+//! ITable::get_read_morsel(), report to next_morsel(). Queries must run in
+//! the same process as the scheduler, i.e. not in SafeEnv.
+struct QueryScheduler {
+	struct Stats {
+		//! Time from start to end of the last run
+		double latency_ms = 0.0;
+		size_t morsels = 0;
+		size_t tuples = 0;
+
+		//! Tuples per second
+		double get_throughput() const {
+			return latency_ms > 0.0 ? 1000.0 * tuples / latency_ms : 0.0;
+		}
+	};
+
+	QueryScheduler(size_t num_slots);
+	~QueryScheduler();
+
+	//! Registers 'q'. At most 'max_threads' of its threads run at the same
+	//! time. 'priority' 0 is low, 1 normal and 2 or more high
+	void add(Query& q, size_t priority, size_t max_threads);
+	void remove(Query& q);
+
+	//! Runs 'f', which starts all work of 'q', in the query's arena
+	void run(Query& q, const std::function<void()>& f);
+
+	//! Called, after 'p' fetched a morsel with 'num' tuples. Invalid
+	//! morsels, i.e. 'num' < 0, are not counted
+	void next_morsel(IPipeline& p, int64_t num);
+
+	Stats get_stats(Query& q);
+
+private:
+	typedef QuerySchedulerEntry::clock clock;
+
+	std::mutex mutex;
+
+	const size_t num_slots;
+	std::unique_ptr<tbb::global_control> parallelism;
+
+	std::unordered_map<Query*, std::unique_ptr<QuerySchedulerEntry>> entries;
+
+	QuerySchedulerEntry& get_entry(Query& q);
+};
+
+#endif
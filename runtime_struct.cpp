@@ -1,8 +1,13 @@
 #include "runtime_struct.hpp"
 #include "runtime_framework.hpp"
 #include "runtime_memory.hpp"
+#include "runtime_scheduler.hpp"
 #include <tbb/tbb.h>
 #include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <unordered_set>
+#include <unistd.h>
 
 inline static u64
 next_power_2(u64 x)
@@ -190,31 +195,34 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 	(void)tmp_old;
 	(void)tmp_ok;
 
-	auto par_insert_pre = [&] (void** next, void* b, void** ptr, void* old) -> bool {
+	// heads carry tags, see BucketTag
+	auto par_insert_pre = [&] (void** next, void* b, void** ptr, void* old, u64 h) -> bool {
 		size_t it = 0;
-		DBG_ASSERT(old != b);
+		DBG_ASSERT(BucketTag::ptr((u64)old) != (u64)b);
 		it++;
-		*next = old;
+		*next = (void*)BucketTag::ptr((u64)old);
 
 		auto atomic = (std::atomic<void*>*)ptr;
-		return atomic->compare_exchange_weak(old, b,
+		return atomic->compare_exchange_weak(old,
+			(void*)BucketTag::head((u64)old, (u64)b, h),
 			std::memory_order_relaxed, std::memory_order_relaxed);
 
 		// return __sync_bool_compare_and_swap(ptr, old, b);
 	};
 
-	auto par_insert_full = [&] (void** next, void* b, void** ptr) {
+	auto par_insert_full = [&] (void** next, void* b, void** ptr, u64 h) {
 		size_t it = 0;
-		while (!par_insert_pre(next, b, ptr, *ptr)) {
+		while (!par_insert_pre(next, b, ptr, *ptr, h)) {
 			it++;
 		}
 	};
 
 
-	auto seq_insert = [&] (void** next, auto b, void** ptr) {
-		DBG_ASSERT(*ptr != b);
-		*next = *ptr;
-		*ptr = b;
+	auto seq_insert = [&] (void** next, auto b, void** ptr, u64 h) {
+		const u64 old = (u64)*ptr;
+		DBG_ASSERT(BucketTag::ptr(old) != (u64)b);
+		*next = (void*)BucketTag::ptr(old);
+		*ptr = (void*)BucketTag::head(old, (u64)b, h);
 	};
 
 	const size_t next_stride = NEXT_STRIDE ? NEXT_STRIDE : _next_stride;
@@ -236,6 +244,7 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 		__m512i vnexts;
 		__m512i vptrs;
 		__m512i vhptrs;
+		__m512i vhs;
 		int stage;
 	} all_states[CONC];
 
@@ -251,6 +260,10 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 	const auto vhashs = _mm512_set1_epi64((u64)hashs);
 	const auto vnexts = _mm512_set1_epi64((u64)nexts);
 	const auto vmask = _mm512_set1_epi64(mask);
+	const auto vptr_mask = _mm512_set1_epi64(BucketTag::kPointerMask);
+	const auto vone = _mm512_set1_epi64(1);
+	const auto vfifteen = _mm512_set1_epi64(15);
+	const auto vtag_shift = _mm512_set1_epi64(BucketTag::kPointerBits);
 
 	while (1) {
 		auto& state = all_states[current % CONC];
@@ -299,6 +312,7 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 		case 1: {
 			auto hs = _mm512_i64gather_epi64(state.vhptrs,
 				nullptr, 1);
+			state.vhs = hs;
 
 			state.vptrs = _mm512_add_epi64(
 				vbuckets,
@@ -322,7 +336,14 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 #if 1
 			auto olds = _mm512_i64gather_epi64(
 				state.vptrs, nullptr, 1);
-			_mm512_i64scatter_epi64(nullptr, state.vnexts, olds, 1);
+			_mm512_i64scatter_epi64(nullptr, state.vnexts,
+				_mm512_and_epi64(olds, vptr_mask), 1);
+
+			// BucketTag::head()
+			auto tags = _mm512_sllv_epi64(vone, _mm512_add_epi64(vtag_shift,
+				_mm512_and_epi64(_mm512_srli_epi64(state.vhs, 32), vfifteen)));
+			auto heads = _mm512_or_epi64(_mm512_or_epi64(state.vbs, tags),
+				_mm512_andnot_epi64(vptr_mask, olds));
 			for (size_t k=0; k<PAR; k++) {
 				void* old = (void*) olds[k];
 #else
@@ -331,7 +352,7 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 #endif
 				auto atomic = (std::atomic<void*>*)state.vptrs[k];
 				auto success = atomic->compare_exchange_weak(old,
-						(void*)state.vbs[k],
+						(void*)heads[k],
 						std::memory_order_relaxed,
 						std::memory_order_relaxed);
 
@@ -347,7 +368,8 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 			if (fail) {
 				for (size_t k=0; k<PAR; k++) {
 					if (fail & (1 << k)) {
-						par_insert_full((void**)state.vnexts[k], (void*)state.vbs[k], (void**)state.vptrs[k]);
+						par_insert_full((void**)state.vnexts[k], (void*)state.vbs[k],
+							(void**)state.vptrs[k], state.vhs[k]);
 					}
 				}
 			}
@@ -381,7 +403,7 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 			auto b = base_ptr + (i0 * width);
 			auto ptr = &buckets[idx];
 			auto next = &nexts[i0 * next_stride];
-			par_insert_full(next, b, ptr);
+			par_insert_full(next, b, ptr, h);
 		}
 		return;
 	}
@@ -398,7 +420,7 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 				const u64 i0 = i+off+pos; \
 				const auto h0 = hashs[i0 * hash_stride]; \
 				u64 idx0 = h0 & mask; \
-				tmp_old[i] = (void*)idx0; \
+				tmp_old[i] = (void*)h0; \
 				tmp_b[i] = base_ptr + (i0 * width); \
 				tmp_ptr[i] = &buckets[idx0]; \
 				tmp_next[i] = &nexts[i0 * next_stride]; \
@@ -434,13 +456,15 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 #define PROLOGUE2(pos, AHEAD) \
 		u64 k##pos=pos+_k; \
 		u64 i##pos = offset+k##pos; \
+		u64 h##pos; \
 		u64 idx##pos; \
 		void* RESTRICT b##pos; \
 		void** RESTRICT ptr##pos; \
 		void** RESTRICT next##pos; \
 		if (PRE_COMP) { \
 			const auto z = k##pos-start; \
-			idx##pos = (u64)tmp_old[z]; \
+			h##pos = (u64)tmp_old[z]; \
+			idx##pos = h##pos & mask; \
 			b##pos = tmp_b[z]; \
 			ptr##pos = tmp_ptr[z]; \
 			next##pos = tmp_next[z]; \
@@ -487,7 +511,7 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 				} \
 			} \
 		} else { \
-			u64 h##pos = hashs[i##pos * hash_stride]; \
+			h##pos = hashs[i##pos * hash_stride]; \
 			idx##pos = h##pos & mask; \
 			b##pos = base_ptr + (i##pos * width); \
 			ptr##pos = &buckets[idx##pos]; \
@@ -504,10 +528,10 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 		bool ok##pos;
 
 #define E(pos) void* old##pos; old##pos = *ptr##pos;
-#define A(pos) ok##pos = par_insert_pre(next##pos, b##pos, ptr##pos, old##pos);
+#define A(pos) ok##pos = par_insert_pre(next##pos, b##pos, ptr##pos, old##pos, h##pos);
 
 #define B(pos) if (!ok##pos) { \
-		par_insert_full(next##pos, b##pos, ptr##pos); \
+		par_insert_full(next##pos, b##pos, ptr##pos, h##pos); \
 	}
 	
 	if (UNROLL == 8) {
@@ -602,7 +626,7 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 		// sequential
 #define A(pos) { \
 		PROLOGUE2(pos, false) \
-		seq_insert(next##pos, b##pos, ptr##pos); \
+		seq_insert(next##pos, b##pos, ptr##pos, h##pos); \
 	} \
 
 		for (; _k+8<num; _k+=8) {
@@ -621,9 +645,9 @@ __reinsert_hash_buckets(void** RESTRICT buckets,
 #define A(pos) { \
 		PROLOGUE2(pos, false); \
 		if (PARALLEL) { \
-			par_insert_full(next##pos, b##pos, ptr##pos); \
+			par_insert_full(next##pos, b##pos, ptr##pos, h##pos); \
 		} else { \
-			seq_insert(next##pos, b##pos, ptr##pos); \
+			seq_insert(next##pos, b##pos, ptr##pos, h##pos); \
 		} \
 	}
 
@@ -841,22 +865,91 @@ IBaseColumn::IBaseColumn(Query& query, const std::string& tbl,
 	size = rel.nrTuples;
 }
 
+void
+IBaseColumn::place_on_nodes(Query& query, size_t width)
+{
+	const size_t num_nodes = Numa::num_nodes();
+	if (!query.config.numa || num_nodes <= 1 || !size) {
+		return;
+	}
+
+	// base tables outlive queries, only move pages once
+	static std::mutex mutex;
+	static std::unordered_set<void*> placed;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!placed.insert(data).second) {
+		return;
+	}
+
+	for (size_t n=0; n<num_nodes; n++) {
+		pos_t begin, end;
+		IBaseTable::get_node_range(begin, end, size, n, num_nodes);
+
+		Numa::bind((char*)data + begin*width, (end - begin)*width, n);
+	}
+}
+
 IBaseTable::IBaseTable(const char* dbg_name, Query& query)
- : query(query)
+ : query(query), num_nodes(query.config.numa ? Numa::num_nodes() : 1)
 {
+	node_offsets.reset(new std::atomic<pos_t>[num_nodes]);
 	reset();
 	query.add_resetable(this);
 }
 
+void
+IBaseTable::reset()
+{
+	morsel_offset = 0;
+	for (size_t n=0; n<num_nodes; n++) {
+		node_offsets[n] = 0;
+	}
+}
+
 IBaseTable::~IBaseTable()
 {
 }
 
 void
 IBaseTable::get_scan_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file, int dbg_line)
+{
+	_get_scan_morsel(morsel, ctx, dbg_file, dbg_line);
+
+	if (query.config.scheduler) {
+		query.config.scheduler->next_morsel(ctx.pipeline, morsel._num);
+	}
+}
+
+void
+IBaseTable::_get_scan_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file, int dbg_line)
 {
 	pos_t morsel_size = query.config.morsel_size;
 
+	if (num_nodes > 1) {
+		// prefer rows on the local node, then help the other nodes
+		const size_t home = Numa::current_node();
+
+		for (size_t i=0; i<num_nodes; i++) {
+			const size_t node = (home + i) % num_nodes;
+			pos_t begin, end;
+			get_node_range(begin, end, capacity, node, num_nodes);
+
+			pos_t offset = begin + node_offsets[node].fetch_add(morsel_size);
+			if (offset < end) {
+				morsel.init(offset, std::min(morsel_size, end - offset));
+
+				LOG_TRACE("get_scan_morsel: node=%lld offset=%lld num=%lld @ %s:%d\n",
+					(long long)node, morsel._offset, morsel._num, dbg_file, dbg_line);
+				return;
+			}
+		}
+
+		morsel.init(capacity, -1);
+		LOG_TRACE("get_scan_morsel: done capacity=%lld\n", capacity);
+		return;
+	}
+
 	morsel.init(morsel_offset.fetch_add(morsel_size), -1);
 
 	if (morsel._offset >= capacity) {
@@ -871,6 +964,12 @@ IBaseTable::get_scan_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_
 		morsel._offset, morsel._num, dbg_file, dbg_line);
 }
 
+LogicalMasterTable::LogicalMasterTable(Query& q)
+{
+	reset();
+	q.add_resetable(this);
+}
+
 void
 LogicalMasterTable::add(ITable& table)
 {
@@ -881,23 +980,184 @@ LogicalMasterTable::add(ITable& table)
 		&table, tables.size());
 }
 
+void
+LogicalMasterTable::get_global_aggregate(Morsel& morsel, MorselContext& ctx)
+{
+	morsel.init(-1, -1);
+
+	if (next_partition.fetch_add(1)) {
+		return;
+	}
+
+	// every thread has accumulated into its own table, at most a few rows
+	char* result = nullptr;
+	for (auto t : tables) {
+		t->m_write_partitions[0]->for_each([&] (Block* b) {
+			for (size_t i=0; i<b->num; i++) {
+				char* row = b->data + i*b->width;
+				if (result) {
+					t->combine_rows(result, row);
+				} else {
+					result = row;
+				}
+			}
+		});
+	}
+
+	if (result) {
+		morsel.init(0, 1, result);
+	}
+
+	auto scheduler = ctx.pipeline.query.config.scheduler;
+	if (scheduler) {
+		scheduler->next_morsel(ctx.pipeline, morsel._num);
+	}
+}
+
+void
+LogicalMasterTable::add_merge_target(ITable& table, bool per_partition)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	merge_targets.push_back(&table);
+	merge_per_partition &= per_partition;
+}
+
+void
+LogicalMasterTable::prepare(size_t num_partitions)
+{
+	std::vector<size_t> rows(num_partitions, 0);
+	shared = merge_targets.empty();
+	for (auto t : tables) {
+		ASSERT(t->m_flush_partitions.size() == num_partitions);
+		for (size_t p=0; p<num_partitions; p++) {
+			auto partition = t->m_flush_partitions[p];
+			rows[p] += partition->num_rows();
+			shared &= !partition->is_spilled();
+		}
+	}
+
+	order.resize(num_partitions);
+	for (size_t p=0; p<num_partitions; p++) {
+		order[p] = p;
+	}
+	std::stable_sort(order.begin(), order.end(), [&] (size_t a, size_t b) {
+		return rows[a] > rows[b];
+	});
+
+	cursor = Cursor { 0, 0, nullptr, 0 };
+}
+
+void
+LogicalMasterTable::get_shared_morsel(Morsel& morsel, size_t num_partitions,
+	size_t morsel_size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto& c = cursor;
+	while (c.partition < num_partitions) {
+		if (c.block) {
+			if (c.offset < c.block->num) {
+				const size_t num = std::min(c.block->num - c.offset, morsel_size);
+				morsel.init(0, num, c.block->data + c.offset*c.block->width);
+				c.offset += num;
+				return;
+			}
+
+			c.block = c.block->next;
+			c.offset = 0;
+			if (c.block) {
+				continue;
+			}
+			c.index++;
+		}
+
+		// first block of the partition in the next table
+		if (c.index >= tables.size()) {
+			c.index = 0;
+			c.partition++;
+			continue;
+		}
+		c.block = tables[c.index]->m_flush_partitions[c.partition]->head;
+		if (!c.block) {
+			c.index++;
+		}
+	}
+
+	morsel.init(-1, -1);
+}
+
 void
 LogicalMasterTable::get_read_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file, int dbg_line)
 {
+	const size_t num_partitions = tables.empty() ?
+		0 : tables[0]->m_flush_partitions.size();
+
+	if (!prepared.load(std::memory_order_acquire)) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!prepared.load(std::memory_order_relaxed)) {
+			prepare(num_partitions);
+			prepared.store(true, std::memory_order_release);
+		}
+	}
+
+	auto scheduler = ctx.pipeline.query.config.scheduler;
+	if (shared) {
+		get_shared_morsel(morsel, num_partitions,
+			ctx.pipeline.query.config.morsel_size);
+		if (scheduler) {
+			scheduler->next_morsel(ctx.pipeline, morsel._num);
+		}
+		return;
+	}
+
+	// previous morsel has been consumed, drop the spilled partition again
+	if (ctx.loaded_space) {
+		ctx.loaded_space->evict();
+		ctx.loaded_space = nullptr;
+	}
+
 	while (1) {
-		if (ctx.index >= tables.size()) {
-			LOG_TRACE("LogicalMasterTable::get_read_morsel: part %lld out\n",
+		if (!ctx.has_partition) {
+			const size_t claim = next_partition.fetch_add(1);
+			ctx.partition = claim < num_partitions ? order[claim] : num_partitions;
+			ctx.has_partition = true;
+			ctx.index = 0;
+			ctx.last_buffer = nullptr;
+			LOG_TRACE("LogicalMasterTable::get_read_morsel: thread %lld claims part %lld\n",
+				ctx.pipeline.thread_id, ctx.partition);
+
+			const size_t thread_id = ctx.pipeline.thread_id;
+			if (ctx.partition < num_partitions && thread_id < merge_targets.size() &&
+					merge_per_partition) {
+				size_t num_rows = 0;
+				for (auto t : tables) {
+					num_rows += t->m_flush_partitions[ctx.partition]->num_rows();
+				}
+				merge_targets[thread_id]->begin_merge_partition(num_rows);
+			}
+		}
+
+		if (ctx.partition >= num_partitions) {
+			LOG_TRACE("LogicalMasterTable::get_read_morsel: thread %lld out\n",
 				ctx.pipeline.thread_id);
-			ASSERT(ctx.index == tables.size());
 			morsel.init(-1, -1);
 			break;
 		}
 
+		if (ctx.index >= tables.size()) {
+			ASSERT(ctx.index == tables.size());
+			// partition done, take the next one
+			ctx.has_partition = false;
+			continue;
+		}
+
 		const size_t index = ctx.index;
 		ASSERT(index < tables.size());
 		auto t = tables[index];
 		ASSERT(t);
-		auto partition = t->m_flush_partitions[ctx.pipeline.thread_id];
+		ASSERT(t->m_flush_partitions.size() == num_partitions);
+		auto partition = t->m_flush_partitions[ctx.partition];
 		ASSERT(partition);
 
 		Block* blk = (Block*)ctx.last_buffer;
@@ -911,7 +1171,7 @@ LogicalMasterTable::get_read_morsel(Morsel& morsel, MorselContext& ctx, const ch
 				"morsel_offset %ld morsel_num %lld morsel_data %p "
 				"block num %lld block cap %lld block width %lld"
 				"\n",
-				ctx.pipeline.thread_id, index, morsel._offset,
+				ctx.partition, index, morsel._offset,
 				morsel._num, morsel.data, blk->num, blk->capacity,
 				blk->width);
 		}
@@ -920,15 +1180,25 @@ LogicalMasterTable::get_read_morsel(Morsel& morsel, MorselContext& ctx, const ch
 		if (blk) {
 			ctx.last_buffer = blk->next;
 		} else {
+			if (partition->is_spilled()) {
+				partition->load();
+			}
 			blk = partition->head;
 			ctx.last_buffer = blk;
 		}
 
 		if (!ctx.last_buffer) {
+			if (partition->is_spilled()) {
+				if (generate_range) {
+					ctx.loaded_space = partition;
+				} else {
+					partition->evict();
+				}
+			}
 			ctx.index++;
 			LOG_TRACE("LogicalMasterTable::get_read_morsel: "
 				"part %lld set table to %lld\n",
-				ctx.pipeline.thread_id, ctx.index);
+				ctx.partition, ctx.index);
 		}
 
 		if (generate_range) {
@@ -936,6 +1206,10 @@ LogicalMasterTable::get_read_morsel(Morsel& morsel, MorselContext& ctx, const ch
 			break;
 		}
 	};
+
+	if (scheduler) {
+		scheduler->next_morsel(ctx.pipeline, morsel._num);
+	}
 }
 
 
@@ -962,46 +1236,70 @@ Block::Block(size_t _width, size_t _capacity, Block* _prev, Block* _next)
 	width = _width;
 	capacity = _capacity;
 	num = 0;
+	dirty = 0;
+	node = Numa::current_node();
 
-	data = (char*) calloc(1, width*capacity);
+	data = (char*)MemoryPool::alloc_zeroed(width*capacity, node);
 }
 
 Block::~Block()
 {
-	free(data);
+	MemoryPool::free(data, width*capacity,
+		std::min(std::max(dirty, num), capacity) * width, node);
 }
 
 
 
-BlockFactory::BlockFactory(size_t width, size_t capacity) noexcept
- : width(width), capacity(capacity)
+BlockFactory::BlockFactory(size_t width, size_t capacity, MemoryAccount* account) noexcept
+ : width(width), capacity(capacity), account(account)
 {
 
 }
 
 Block*
-BlockFactory::new_block(Block* prev, Block* next)
+BlockFactory::new_block(Block* prev, Block* next, size_t block_capacity)
+{
+	if (!block_capacity) {
+		block_capacity = capacity;
+	}
+	// fill the whole size class, the pool hands it out again for any
+	// request of the same class
+	block_capacity = MemoryPool::size_class(width*block_capacity) / width;
+	if (account) {
+		account->charge(width*block_capacity);
+	}
+	return new Block(width, block_capacity, prev, next);
+}
+
+void
+BlockFactory::free_block(Block* block)
 {
-	return new Block(width, capacity, prev, next);
+	const size_t bytes = width*block->capacity;
+	delete block;
+	if (account) {
+		account->release(bytes);
+	}
 }
 
 
 
 
-BlockedSpace::BlockedSpace(size_t width, size_t capacity) noexcept
- : head(nullptr), tail(nullptr), factory(width, capacity)
+BlockedSpace::BlockedSpace(size_t width, size_t capacity, MemoryAccount* account) noexcept
+ : head(nullptr), tail(nullptr), factory(width, capacity, account)
 {
 }
 
 Block*
-BlockedSpace::new_block_at_end()
+BlockedSpace::new_block_at_end(size_t capacity)
 {
-	Block* b = factory.new_block(tail, nullptr);
+	Block* b = factory.new_block(tail, nullptr, capacity);
 
 	LOG_TRACE("new_block_at_end: %p cap=%lld width=%lld\n",
 		b->data, b->capacity, b->width);
 	if (!head) {
 		head = b;
+	} else {
+		tail->next = b;
 	}
 	tail = b;
 	return b;
@@ -1014,87 +1312,174 @@ BlockedSpace::reset()
 	Block* b = head;
 	while (b) {
 		Block* next = b->next;
-		delete b;
+		factory.free_block(b);
 		b = next;
 	}
 
 	head = nullptr;
 	tail = nullptr;
+
+	if (!spill_file.empty()) {
+		unlink(spill_file.c_str());
+		spill_file.clear();
+	}
+	spilled_bytes = 0;
+	loaded = false;
 }
 
-size_t
-BlockedSpace::size() const
+void
+BlockedSpace::spill(const std::string& dir)
 {
-	size_t n=0;
+	if (loaded) {
+		// rows are already on disk
+		evict();
+		return;
+	}
 
+	if (spill_file.empty()) {
+		static std::atomic<size_t> g_spill_counter(0);
+		spill_file = dir + "/voila_spill_" + std::to_string(getpid()) + "_" +
+			std::to_string(g_spill_counter++);
+	}
+
+	FILE* f = fopen(spill_file.c_str(), "ab");
+	if (!f) {
+		throw std::runtime_error("Cannot open spill file '" + spill_file + "'");
+	}
+
+	bool ok = true;
 	for_each([&] (auto blk) {
-		n += blk->size();
+		const size_t bytes = blk->num * blk->width;
+		if (ok && bytes > 0) {
+			ok = fwrite(blk->data, 1, bytes, f) == bytes;
+			spilled_bytes += bytes;
+		}
+		factory.free_block(blk);
 	});
-	return n;
+	head = nullptr;
+	tail = nullptr;
+
+	if (fclose(f) || !ok) {
+		throw std::runtime_error("Cannot write spill file '" + spill_file + "'");
+	}
+
+	LOG_DEBUG("BlockedSpace::spill: %s bytes=%lld\n", spill_file.c_str(),
+		spilled_bytes);
 }
 
 void
-BlockedSpace::partition_data(BlockedSpace** partitions, size_t num_partitions,
-	u64* hashes, size_t hash_stride, char* data, size_t width,
-	size_t total_num)
+BlockedSpace::load()
 {
-	const size_t vsize = 1024;
-
-	u64 tmp_hashes[vsize];
-	char* part_buf[num_partitions];
-	size_t part_num[num_partitions];
-	Block* part_blk[num_partitions];
-
-	// make sure everything fits & set buffers
-	for (size_t i=0; i<num_partitions; i++) {
-		Block* b = partitions[i]->append(total_num);
+	ASSERT(!spill_file.empty());
+	if (loaded) {
+		return;
+	}
 
-		part_blk[i] = b;
-		part_buf[i] = b->data + (b->num * width);
-		part_num[i] = b->num;
+	FILE* f = fopen(spill_file.c_str(), "rb");
+	if (!f) {
+		throw std::runtime_error("Cannot open spill file '" + spill_file + "'");
 	}
 
-	LOG_DEBUG("partition data %p total %lld\n", data, total_num);
+	const size_t width = factory.width;
+	size_t num_rows = spilled_bytes / width;
+	while (num_rows > 0) {
+		const size_t num = std::min(num_rows, factory.capacity);
+		Block* b = append(num);
+		const size_t bytes = num * width;
+		if (fread(b->data + b->num*width, 1, bytes, f) != bytes) {
+			fclose(f);
+			throw std::runtime_error("Cannot read spill file '" + spill_file + "'");
+		}
+		b->num += num;
+		num_rows -= num;
+	}
 
-	// partition
-	for (size_t offset=0; offset < total_num; offset += vsize) {
-		const size_t num = std::min(total_num - offset, vsize);
+	fclose(f);
+	loaded = true;
+}
 
-		// fetch hashes
-		fetch<u64>(tmp_hashes, hashes, hash_stride, num, offset);
+void
+BlockedSpace::evict()
+{
+	if (!loaded) {
+		return;
+	}
 
-		for (size_t i=0; i<num; i++) {
-			ASSERT(tmp_hashes[i] != 0);
-		}
+	for_each([&] (auto blk) {
+		factory.free_block(blk);
+	});
+	head = nullptr;
+	tail = nullptr;
+	loaded = false;
+}
 
-		// partition
-		runtime_partition(part_num, part_buf, num_partitions, data, width,
-			tmp_hashes, num, offset);
-	}
+size_t
+BlockedSpace::size() const
+{
+	size_t n=0;
 
-	// maintain counts
-	for (size_t i=0; i<num_partitions; i++) {
-		part_blk[i]->num += part_num[i];
-	}
+	for_each([&] (auto blk) {
+		n += blk->size();
+	});
+	return n;
 }
 
 void
-BlockedSpace::partition(BlockedSpace** partitions, size_t num_partitions,
-	size_t hash_offset, size_t hash_stride) const
+BlockedSpace::radix_partition(BlockedSpace** partitions, size_t num_partitions,
+	size_t shift, size_t hash_offset, size_t hash_stride) const
 {
 	const size_t width = factory.width;
+	const u64 mask = num_partitions - 1;
+	ASSERT(num_partitions > 0 && !(num_partitions & mask));
+
+	const size_t vsize = 1024;
+	u16 ids[vsize];
+	std::vector<size_t> part_num(num_partitions, 0);
+	std::vector<char*> part_buf(num_partitions, nullptr);
+	std::vector<Block*> part_blk(num_partitions, nullptr);
+
+	auto for_each_vector = [&] (auto f) {
+		for_each([&] (auto block) {
+			const u64* hashes = (const u64*)(block->data + hash_offset);
+			for (size_t offset=0; offset < block->num; offset += vsize) {
+				const size_t num = std::min(block->num - offset, vsize);
+
+				runtime_radix_ids(ids, hashes + offset*hash_stride, hash_stride,
+					num, shift, mask);
+				f(block->data + offset*width, num);
+			}
+		});
+	};
+
+	// histogram
+	for_each_vector([&] (const char*, size_t num) {
+		for (size_t i=0; i<num; i++) {
+			part_num[ids[i]]++;
+		}
+	});
+
+	// reserve exactly, then scatter
+	for (size_t i=0; i<num_partitions; i++) {
+		if (!part_num[i]) {
+			continue;
+		}
 
-	size_t num = 0;
+		Block* b = partitions[i]->reserve(part_num[i]);
+		part_blk[i] = b;
+		part_buf[i] = b->data + (b->num * width);
+	}
 
-	for_each([&] (auto block) {
-		num++;
-		char* blk_data = block->data;
-		u64* blk_hashes = (u64*)(blk_data + hash_offset);
-		partition_data(partitions, num_partitions, blk_hashes, hash_stride,
-			blk_data, width, block->num);
+	RadixScatter scatter(&part_buf[0], num_partitions, width);
+	for_each_vector([&] (const char* rows, size_t num) {
+		scatter.scatter(rows, ids, num);
 	});
+	scatter.finish();
 
-	ASSERT(!num == !head);
+	for (size_t i=0; i<num_partitions; i++) {
+		if (part_blk[i]) {
+			part_blk[i]->num += part_num[i];
+		}
+	}
 }
 
 
@@ -1106,11 +1491,18 @@ BlockedSpace::~BlockedSpace() {
 
 
 ITable::ITable(const char* dbg_name, Query& q, LogicalMasterTable* master_table,
-	size_t row_width, bool fully_thread_local, bool flush_to_part)
+	size_t row_width, bool fully_thread_local, bool flush_to_part,
+	bool open_addressing, size_t expected_rows, bool radix_partitioned,
+	bool global_aggregate)
  : dbg_name(dbg_name), query(q), m_fully_thread_local(fully_thread_local),
  		m_flush_to_partitions(flush_to_part), m_row_width(row_width),
- 		m_master_table(master_table)
+ 		m_open_addressing(open_addressing), m_master_table(master_table),
+ 		m_memory(&q.memory, dbg_name ? dbg_name : "table"),
+ 		m_expected_rows(expected_rows), m_radix_partitioned(radix_partitioned),
+ 		m_global_aggregate(global_aggregate)
  {
+	ASSERT(!m_radix_partitioned || !m_fully_thread_local);
+
 	size_t num_write_parts = query.config.num_threads;
 
 	if (m_fully_thread_local) {
@@ -1118,15 +1510,15 @@ ITable::ITable(const char* dbg_name, Query& q, LogicalMasterTable* master_table,
 	}
 
 	auto new_space = [&] () {
-		return new BlockedSpace(m_row_width, m_block_capacity);
+		return new BlockedSpace(m_row_width, m_block_capacity, &m_memory);
 	};
 
 	for (size_t t=0; t<num_write_parts; t++) {
 		m_write_partitions.push_back(new_space());
 	}
 
-	if (m_flush_to_partitions) {
-		for (size_t t=0; t<q.config.num_threads; t++) {
+	if (m_flush_to_partitions && !m_global_aggregate) {
+		for (size_t t=0; t<q.config.get_num_flush_partitions(); t++) {
 			m_flush_partitions.push_back(new_space());
 		}
 	}
@@ -1145,6 +1537,9 @@ ITable::~ITable()
 	ForEachSpace([&] (auto space) {
 		delete space;
 	});
+
+	delete hash_index_buffer;
+	delete hash_index_old_buffer;
 }
 
 void
@@ -1159,6 +1554,31 @@ ITable::reset_pointers()
 	ASSERT(false && "overwritten");
 }
 
+void
+ITable::combine_rows(char*, const char*) const
+{
+	ASSERT(false && "overwritten");
+}
+
+void
+ITable::init_global_row(char* row) const
+{
+	(void)row;
+}
+
+char*
+ITable::new_global_row()
+{
+	ASSERT(m_global_aggregate && m_fully_thread_local);
+
+	Block* block = m_write_partitions[0]->append(1);
+	char* row = block->data + (block->width * block->num);
+	block->num++;
+
+	init_global_row(row);
+	return row;
+}
+
 void
 ITable::reset()
 {
@@ -1168,7 +1588,19 @@ ITable::reset()
 		space->reset();
 	});
 
-	build_index(true, nullptr);
+	m_scan_partition = 0;
+	m_scan_block = nullptr;
+	m_scan_offset = 0;
+
+	m_radix_partitions = 0;
+	m_radix_shift = 0;
+	m_radix_count = 0;
+	m_radix_next_build = 0;
+
+	// global aggregates hold a single row per thread, see new_global_row()
+	if (!m_global_aggregate) {
+		build_index(true, nullptr);
+	}
 }
 
 template<typename T>
@@ -1203,10 +1635,40 @@ create_hash_index_for_block(void** buckets, u64 mask, const Block& block,
 	}
 }
 
+static void
+create_open_hash_index_for_block(u64* slots, u64 mask, const Block& block,
+	size_t hash_offset, size_t next_offset, bool parallel)
+{
+	const size_t num = block.num;
+	const size_t width = block.width;
+	constexpr size_t kPrefetchDistance = 16;
+
+	char* row = block.data;
+	for (size_t i=0; i<num; i++, row += width) {
+		if (i + kPrefetchDistance < num) {
+			const u64 h = *(u64*)(row + kPrefetchDistance*width + hash_offset);
+			__builtin_prefetch(&slots[h & mask], 1);
+		}
+
+		const u64 hash = *(u64*)(row + hash_offset);
+		*(u64*)(row + next_offset) = parallel ?
+			OpenHashIndex::insert_atomic(slots, mask, hash, row) :
+			OpenHashIndex::insert(slots, mask, hash, row);
+	}
+}
+
 void
 ITable::create_hash_index_handle_space(void** buckets, u64 mask,
 	const size_t* thread_id, bool parallel, const BlockedSpace* space)
 {
+	if (m_open_addressing) {
+		space->for_each([&] (Block* block) {
+			create_open_hash_index_for_block((u64*)buckets, mask, *block,
+				hash_offset, next_offset, parallel);
+		});
+		return;
+	}
+
 	// not used
 	const int kVectorSize = kChunkSize;
 	void** chk_ptr[kVectorSize];
@@ -1249,7 +1711,21 @@ ITable::create_hash_index(void** buckets, u64 mask, const size_t* thread_id)
 
 	bool parallel = !m_fully_thread_local && query.config.num_threads > 0;
 
-	if (parallel && thread_id) {
+	if (parallel && thread_id && m_radix_partitions) {
+		// claim whole partitions. Rows of a partition only hit its range of
+		// buckets, no other thread inserts there. Open addressing might
+		// probe beyond the range, so it still needs atomic inserts
+		const size_t num_parts = m_radix_partitions;
+		const size_t num_threads = m_write_partitions.size();
+		ASSERT(m_flush_partitions.size() == num_threads * num_parts);
+
+		for (size_t p = m_radix_next_build++; p < num_parts; p = m_radix_next_build++) {
+			for (size_t t=0; t<num_threads; t++) {
+				create_hash_index_handle_space(buckets, mask, thread_id,
+					m_open_addressing, m_flush_partitions[t*num_parts + p]);
+			}
+		}
+	} else if (parallel && thread_id) {
 		size_t tid = *thread_id;
 		ASSERT(tid < m_write_partitions.size());
 		create_hash_index_handle_space(buckets, mask, &tid,
@@ -1273,6 +1749,12 @@ ITable::remove_hash_index()
 	if (hash_index_buffer) {
 		hash_index_buffer->free();
 	}
+	if (hash_index_old) {
+		hash_index_old = nullptr;
+		hash_index_old_buffer->free();
+	}
+	hash_index_split = 0;
+	hash_index_split_end = 0;
 	hash_index_mask = 0;
 	hash_index_capacity = 0;
 	hash_index_tuple_counter_seq = 0;
@@ -1282,7 +1764,9 @@ ITable::remove_hash_index()
 bool
 ITable::build_index(bool force, IPipeline* pipeline)
 {
-	const size_t count = get_non_flushed_table_count();
+	// radix partitioning has emptied the write partitions
+	const size_t count = m_radix_partitions ? m_radix_count :
+		std::max(get_non_flushed_table_count(), m_expected_rows);
 	const size_t new_num_buckets = calc_num_buckets(query.config, count);
 	const u64 mask = new_num_buckets - 1;
 
@@ -1304,16 +1788,7 @@ ITable::build_index(bool force, IPipeline* pipeline)
 			LOG_DEBUG("build_index(%p, %s): count %d\n", this, dbg_name, count);
 
 			// create new hash index
-			hash_index_mask = mask;
-			hash_index_capacity = new_num_buckets;
-			ASSERT(new_num_buckets > 0);
-
-			if (!hash_index_buffer) {
-				hash_index_buffer = new LargeBuffer();
-			}
-			hash_index_buffer->alloc(sizeof(void*) * new_num_buckets);
-			hash_index_head = hash_index_buffer->get<void*>();
-			ASSERT(hash_index_head);
+			alloc_hash_index(new_num_buckets);
 		}
 	}
 
@@ -1323,21 +1798,159 @@ ITable::build_index(bool force, IPipeline* pipeline)
 	return true;
 }
 
+void
+ITable::alloc_hash_index(size_t num_buckets)
+{
+	ASSERT(num_buckets > 0 && !hash_index_head);
+	hash_index_mask = num_buckets - 1;
+	hash_index_capacity = num_buckets;
+
+	if (!hash_index_buffer) {
+		hash_index_buffer = new LargeBuffer(&m_memory);
+	}
+	// shared index is probed from all nodes, spread it evenly
+	hash_index_buffer->alloc(sizeof(void*) * num_buckets,
+		!m_fully_thread_local && query.config.numa);
+	hash_index_head = hash_index_buffer->get<void*>();
+	ASSERT(hash_index_head);
+}
+
+void
+ITable::begin_merge_partition(size_t num_rows)
+{
+	ASSERT(m_fully_thread_local);
+
+	// inserts grow the index, once the groups plus a vector of candidates
+	// exceed 50% load
+	const size_t num_buckets = next_power_2(std::max(
+		2 * (num_rows + query.config.vector_size),
+		query.config.min_bucket_count));
+
+	if (hash_index_head && num_buckets == hash_index_capacity &&
+			!is_index_splitting()) {
+		hash_index_buffer->reset();
+	} else {
+		remove_hash_index();
+		alloc_hash_index(num_buckets);
+	}
+	hash_index_tuple_counter_seq = 0;
+}
+
+void
+ITable::grow_index(size_t num)
+{
+	const size_t count = get_non_flushed_table_count() + num;
+	const size_t new_num_buckets = calc_num_buckets(query.config, count);
+
+	// open addressing cannot split buckets, shared tables are read
+	// concurrently. Far off estimates rather rebuild at once
+	if (!query.config.incremental_index_growth || m_open_addressing ||
+			!m_fully_thread_local || !hash_index_head ||
+			new_num_buckets != 2 * hash_index_capacity) {
+		build_index(false, nullptr);
+		return;
+	}
+
+	if (hash_index_old) {
+		split_buckets(hash_index_split_end);
+	}
+	ASSERT(!hash_index_old);
+
+	LOG_DEBUG("grow_index(%p, %s): count %d\n", this, dbg_name, count);
+
+	const size_t half = hash_index_capacity;
+	std::swap(hash_index_buffer, hash_index_old_buffer);
+	if (!hash_index_buffer) {
+		hash_index_buffer = new LargeBuffer(&m_memory);
+	}
+	hash_index_buffer->alloc(sizeof(void*) * new_num_buckets, false);
+
+	// both halves start with the old chains, which are supersets of the
+	// split chains. Hence lookups with the new mask stay correct
+	void** heads = hash_index_buffer->get<void*>();
+	memcpy(heads, hash_index_head, sizeof(void*) * half);
+	memcpy(heads + half, hash_index_head, sizeof(void*) * half);
+
+	hash_index_old = hash_index_head;
+	hash_index_head = heads;
+	hash_index_mask = new_num_buckets - 1;
+	hash_index_capacity = new_num_buckets;
+	hash_index_split = 0;
+	hash_index_split_end = half;
+
+	// like a rebuild, wait for another 'half' rows before growing again
+	hash_index_tuple_counter_seq = 0;
+}
+
+void
+ITable::split_buckets(size_t num)
+{
+	const size_t half = hash_index_split_end;
+	const size_t end = std::min(half, hash_index_split + num);
+	u64* heads = (u64*)hash_index_head;
+	const u64* old = (const u64*)hash_index_old;
+
+	for (size_t i = hash_index_split; i < end; i++) {
+		u64 split[2] = {0, 0};
+
+		auto relink = [&] (u64 row, u64 stop) {
+			while (row != stop) {
+				const u64 next = *(u64*)(row + next_offset);
+				const u64 hash = *(u64*)(row + hash_offset);
+				u64& head = split[(hash & half) != 0];
+
+				*(u64*)(row + next_offset) = BucketTag::ptr(head);
+				head = BucketTag::head(head, row, hash);
+				row = next;
+			}
+		};
+
+		// rows inserted since the doubling, then the shared old chain
+		const u64 shared = BucketTag::ptr(old[i]);
+		relink(BucketTag::ptr(heads[i]), shared);
+		relink(BucketTag::ptr(heads[i + half]), shared);
+		relink(shared, 0);
+
+		heads[i] = split[0];
+		heads[i + half] = split[1];
+	}
+
+	hash_index_split = end;
+	if (end == half) {
+		hash_index_old = nullptr;
+		hash_index_old_buffer->free();
+	}
+}
+
 void
 ITable::flush2partitions()
 {
+	if (m_radix_partitioned) {
+		radix_partition();
+		return;
+	}
+
 	ASSERT(m_write_partitions.size() == 1);
 	ASSERT(m_master_table);
 
-	if (!m_flush_partitions.size()) {
-		for (size_t i=0; i<query.config.num_threads; i++) {
-			m_flush_partitions.push_back(new BlockedSpace(m_row_width, m_block_capacity));
-		}
+	// the probe side of a radix join needs the partitions of the build side
+	const size_t num_partitions = m_radix_source ?
+		m_radix_source->m_radix_partitions :
+		query.config.get_num_flush_partitions();
+	ASSERT(num_partitions > 0);
+
+	while (m_flush_partitions.size() > num_partitions) {
+		delete m_flush_partitions.back();
+		m_flush_partitions.pop_back();
+	}
+	while (m_flush_partitions.size() < num_partitions) {
+		m_flush_partitions.push_back(new BlockedSpace(m_row_width, m_block_capacity, &m_memory));
 	}
 
 	// flush
 	BlockedSpace* bspace = m_write_partitions[0];
-	bspace->partition(&m_flush_partitions[0], m_flush_partitions.size(),
+	bspace->radix_partition(&m_flush_partitions[0], num_partitions,
+		m_radix_source ? m_radix_source->m_radix_shift : kFlushPartitionShift,
 		hash_offset, hash_stride);
 
 	// remove flushed tuples from table
@@ -1347,18 +1960,128 @@ ITable::flush2partitions()
 	if (hash_index_head) {
 		remove_hash_index();
 	}
+
+	if (query.config.spill_limit) {
+		spill_flush_partitions(query.config.spill_limit);
+	}
+}
+
+void
+ITable::init_radix_partitions()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (m_radix_partitions) {
+		return;
+	}
+
+	// no thread has partitioned its rows yet, they are all counted
+	const size_t count = get_non_flushed_table_count();
+	const size_t num_buckets = calc_num_buckets(query.config, count);
+	const size_t bytes = count*m_row_width + num_buckets*sizeof(void*);
+
+	// one pass over the rows, the fan-out is bounded to keep TLB misses low
+	const size_t max_partitions = 1024;
+	size_t num_parts = next_power_2(
+		bytes / std::max(query.config.radix_join_partition_bytes, (size_t)1) + 1);
+	num_parts = std::min(num_parts, std::min(num_buckets, max_partitions));
+
+	// partitions are the upper bits of the bucket index 'hash & mask'
+	const size_t num_threads = m_write_partitions.size();
+	if (m_flush_partitions.size() != num_threads * num_parts) {
+		for (auto& part : m_flush_partitions) {
+			delete part;
+		}
+		m_flush_partitions.clear();
+		for (size_t i=0; i<num_threads * num_parts; i++) {
+			m_flush_partitions.push_back(new BlockedSpace(m_row_width, m_block_capacity, &m_memory));
+		}
+	}
+
+	m_radix_shift = __builtin_ctzll(num_buckets) - __builtin_ctzll(num_parts);
+	m_radix_count = count;
+	m_radix_next_build = 0;
+	m_radix_partitions = num_parts;
+
+	LOG_DEBUG("init_radix_partitions(%s): count %lld partitions %lld shift %lld\n",
+		dbg_name, count, num_parts, m_radix_shift);
+}
+
+void
+ITable::radix_partition()
+{
+	ASSERT(!m_fully_thread_local);
+	init_radix_partitions();
+
+	const size_t tid = IPipeline::current_thread_id();
+	ASSERT(tid < m_write_partitions.size());
+
+	BlockedSpace* bspace = m_write_partitions[tid];
+	bspace->radix_partition(&m_flush_partitions[tid * m_radix_partitions],
+		m_radix_partitions, m_radix_shift, hash_offset, hash_stride);
+	bspace->reset();
+}
+
+void
+ITable::spill_flush_partitions(size_t limit)
+{
+	// hybrid hash aggregation: keep small partitions in memory, the largest
+	// ones go to disk and are read back one at a time by LogicalMasterTable
+	std::vector<std::pair<size_t, BlockedSpace*>> parts;
+	parts.reserve(m_flush_partitions.size());
+	for (auto& part : m_flush_partitions) {
+		if (!part->head) {
+			continue;
+		}
+		if (part->is_spilled()) {
+			// partition lives on disk, append the newly flushed rows
+			part->spill(query.config.spill_dir);
+			continue;
+		}
+		parts.emplace_back(part->size(), part);
+	}
+	std::sort(parts.begin(), parts.end(), [] (const auto& a, const auto& b) {
+		return a.first > b.first;
+	});
+
+	for (auto& part : parts) {
+		if (query.memory.current() <= limit) {
+			break;
+		}
+		part.second->spill(query.config.spill_dir);
+	}
 }
 
 void
 ITable::get_read_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file, int dbg_line)
 {
+	if (m_global_aggregate) {
+		ASSERT(m_master_table);
+		m_master_table->get_global_aggregate(morsel, ctx);
+		return;
+	}
+
 	if (m_master_table) {
 		ASSERT(m_flush_partitions.size() > 0);
 		m_master_table->get_read_morsel(morsel, ctx);
 		return;
 	}
 
-	ASSERT(m_fully_thread_local && "todo: implement shared scan");
+	if (m_fully_thread_local) {
+		get_local_read_morsel(morsel, ctx);
+	} else {
+		get_shared_read_morsel(morsel);
+	}
+
+	auto scheduler = ctx.pipeline.query.config.scheduler;
+	if (scheduler) {
+		scheduler->next_morsel(ctx.pipeline, morsel._num);
+	}
+}
+
+void
+ITable::get_local_read_morsel(Morsel& morsel, MorselContext& ctx)
+{
 	ASSERT(m_write_partitions.size() == 1);
 
 	Block* blk = (Block*)ctx.last_buffer;
@@ -1386,6 +2109,48 @@ ITable::get_read_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file
 	morsel.init(0, blk->num, blk->data);
 }
 
+void
+ITable::get_shared_read_morsel(Morsel& morsel)
+{
+	std::lock_guard<std::mutex> lock(m_scan_mutex);
+
+	while (m_scan_partition < m_write_partitions.size()) {
+		Block* blk = m_scan_block ?
+			m_scan_block : m_write_partitions[m_scan_partition]->head;
+
+		if (blk && m_scan_offset < blk->num) {
+			const size_t num = std::min(query.config.morsel_size,
+				blk->num - m_scan_offset);
+
+			morsel.init(0, num, blk->data + (m_scan_offset*blk->width));
+			m_scan_block = blk;
+			m_scan_offset += num;
+			return;
+		}
+
+		// go to next block
+		if (blk && blk->next) {
+			m_scan_block = blk->next;
+		} else {
+			m_scan_block = nullptr;
+			m_scan_partition++;
+		}
+		m_scan_offset = 0;
+	}
+
+	morsel.init(-1, -1);
+}
+
+BlockedSpace*
+ITable::get_thread_write_partition()
+{
+	ASSERT(!m_fully_thread_local);
+
+	const size_t id = IPipeline::current_thread_id();
+	ASSERT(id < m_write_partitions.size());
+	return m_write_partitions[id];
+}
+
 ITable::ThreadView::ThreadView(ITable& t, IPipeline& pipeline)
  : table(t)
 {
@@ -1402,9 +2167,57 @@ ITable::ThreadView::ThreadView(ITable& t, IPipeline& pipeline)
 
 
 IHashTable::IHashTable(const char* dbg_name, Query& q, LogicalMasterTable* master_table,
-	size_t row_width, bool fully_thread_local, bool flush_to_part)
- : ITable(dbg_name, q, master_table, row_width, fully_thread_local, flush_to_part)
+	size_t row_width, bool fully_thread_local, bool flush_to_part,
+	bool open_addressing, size_t expected_rows, bool radix_partitioned,
+	bool global_aggregate)
+ : ITable(dbg_name, q, master_table, row_width, fully_thread_local, flush_to_part,
+ 		open_addressing, expected_rows, radix_partitioned, global_aggregate)
+{
+}
+
+bool
+IHashTable::shared_link(char* row)
+{
+	ASSERT(!m_open_addressing);
+
+	const u64 hash = *(u64*)(row + hash_offset);
+	u64* head = (u64*)&get_hash_index()[hash & get_hash_index_mask()];
+
+	// Rows are only ever prepended, so after a failed CAS, just the rows
+	// in front of 'checked' need to be compared. Relies on x86-TSO to
+	// publish keys and hash, written before, together with the row
+	u64 old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+	u64 checked = 0;
+
+	while (1) {
+		if (old & BucketTag::tag(hash)) {
+			for (u64 p = BucketTag::ptr(old); p && p != checked;
+					p = *(u64*)(p + next_offset)) {
+				const char* other = (const char*)p;
+				if (*(const u64*)(other + hash_offset) == hash && keys_equal(other, row)) {
+					return false;
+				}
+			}
+		}
+
+		checked = BucketTag::ptr(old);
+		*(u64*)(row + next_offset) = checked;
+
+		if (__atomic_compare_exchange_n(head, &old,
+				BucketTag::head(old, (u64)row, hash), false,
+				__ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+			return true;
+		}
+	}
+}
+
+bool
+IHashTable::keys_equal(const char* a, const char* b) const
 {
+	(void)a;
+	(void)b;
+	ASSERT(false && "overwritten");
+	return false;
 }
 
 void
@@ -3,19 +3,32 @@
 
 #include "runtime.hpp"
 #include "runtime_utils.hpp"
+#include "runtime_memory.hpp"
 
 #include <atomic>
 #include <mutex>
 #include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <limits>
 
 struct Query;
 struct IPipeline;
 
+struct BlockedSpace;
+
 struct MorselContext : IResetable {
 	IPipeline& pipeline;
 	size_t index;
 	void* last_buffer;
 
+	//! Flush partition currently read, only valid if 'has_partition'
+	size_t partition;
+	bool has_partition;
+
+	//! Spilled partition read last, evicted once its last morsel is done
+	BlockedSpace* loaded_space;
+
 	MorselContext(IPipeline& p) : pipeline(p) {
 		reset();
 	}
@@ -23,6 +36,9 @@ struct MorselContext : IResetable {
 	virtual void reset() final {
 		index = 0;
 		last_buffer = nullptr;
+		partition = 0;
+		has_partition = false;
+		loaded_space = nullptr;
 	}
 };
 
@@ -159,6 +175,11 @@ struct IBaseColumn {
 
 	IBaseColumn(Query& q, const std::string& tbl, const std::string& col,
 		size_t max_len, int varlen);
+
+protected:
+	//! Binds rows of the n-th NUMA node's scan range (see IBaseTable) to
+	//! node n. Done once per column
+	void place_on_nodes(Query& q, size_t width);
 };
 
 template<typename T> struct BaseColumn : IBaseColumn {
@@ -174,7 +195,11 @@ template<typename T> struct BaseColumn : IBaseColumn {
 
 	BaseColumn(Query& q, const std::string& tbl, const std::string& col,
 		size_t max_len, int varlen)
-	 : IBaseColumn(q, tbl, col, max_len, varlen) {}
+	 : IBaseColumn(q, tbl, col, max_len, varlen) {
+		if (!varlen) {
+			place_on_nodes(q, sizeof(T));
+		}
+	}
 };
 
 struct IBaseTable : IResetable {
@@ -183,10 +208,21 @@ struct IBaseTable : IResetable {
 
 	std::atomic<pos_t> morsel_offset;
 
+	//! Scan cursor per NUMA node, relative to the node's range of rows
+	std::unique_ptr<std::atomic<pos_t>[]> node_offsets;
+	const size_t num_nodes;
+
+	void _get_scan_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file, int dbg_line);
+
 public:
 	IBaseTable(const char* dbg_name, Query& query);
-	virtual void reset() override {
-		morsel_offset = 0;
+	virtual void reset() override;
+
+	//! Rows [begin, end) placed on the given NUMA node
+	static void get_node_range(pos_t& begin, pos_t& end, pos_t capacity,
+		size_t node, size_t num_nodes) {
+		begin = capacity * node / num_nodes;
+		end = capacity * (node+1) / num_nodes;
 	}
 
 	void get_scan_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file = nullptr, int dbg_line = -1);
@@ -206,15 +242,70 @@ public:
 #define GET_READ_MORSEL(t, m, c) t->get_read_morsel(m, c) 
 
 struct ITable;
+struct Block;
 
-struct LogicalMasterTable {
+struct LogicalMasterTable : IResetable {
 	std::mutex mutex;
 
 	std::vector<ITable*> tables;
 
+	//! Next flush partition to hand out. Readers claim whole partitions,
+	//! so that idle threads take over partitions of busy ones. Large
+	//! partitions go first, see 'order'
+	std::atomic<size_t> next_partition;
+
+	//! Per thread, the table re-aggregating the partitions the thread
+	//! claims. Added in thread order, as Query::init() creates them
+	std::vector<ITable*> merge_targets;
+
+	//! Merge targets start over with an empty index per claimed partition.
+	//! Only valid, if a thread is done with all rows of a partition, once
+	//! it gets a morsel of the next one. Concurrent FSMs or buffers still
+	//! hold rows of the previous partition, which would not find their
+	//! groups in the new index
+	bool merge_per_partition = true;
+
+	LogicalMasterTable(Query& q);
+
+	void reset() override {
+		next_partition = 0;
+		prepared = false;
+	}
+
 	void add(ITable& table);
+	//! See 'merge_per_partition', which all merge targets must allow
+	void add_merge_target(ITable& table, bool per_partition);
 
 	void get_read_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file = nullptr, int dbg_line = -1);
+
+	//! Combines the rows of all global aggregate tables into the first
+	//! non-empty one and returns it to the first reader only
+	void get_global_aggregate(Morsel& morsel, MorselContext& ctx);
+
+private:
+	//! Set up by the first reader, once all partitions are flushed
+	std::atomic<bool> prepared;
+
+	//! Partitions by decreasing #rows, so that a large partition does not
+	//! start last and keep one thread busy, while the others idle
+	std::vector<size_t> order;
+
+	//! Without merge targets, rows of a partition need not be read by one
+	//! thread. All readers then share 'cursor' and get morsels of at most
+	//! 'morsel_size' rows, so that all threads read a large partition.
+	//! Not with spilled partitions, which are loaded and evicted by one reader
+	bool shared;
+
+	struct Cursor {
+		size_t partition;
+		size_t index;
+		Block* block;
+		size_t offset;
+	} cursor;
+
+	void prepare(size_t num_partitions);
+	void get_shared_morsel(Morsel& morsel, size_t num_partitions,
+		size_t morsel_size);
 };
 
 struct BlockFactory;
@@ -229,6 +320,15 @@ struct Block {
 	Block* prev;
 	Block* next;
 
+	//! Rows that might have been written, i.e. reserved by BlockedSpace::append
+	//! or reserve. MemoryPool only zeroes these rows, before it hands 'data'
+	//! out again. Whoever writes rows without append() or reserve() must
+	//! raise 'dirty' (or 'num') past them, or the next owner reads stale rows
+	size_t dirty;
+
+	//! NUMA node of the allocating thread, 'data' returns to its free list
+	size_t node;
+
 private:
 	friend class BlockFactory;
 
@@ -249,10 +349,13 @@ public:
 struct BlockFactory {
 	const size_t width;
 	const size_t capacity;
+	MemoryAccount* const account;
 
-	BlockFactory(size_t width, size_t capacity) noexcept;
+	BlockFactory(size_t width, size_t capacity, MemoryAccount* account) noexcept;
 
-	Block* new_block(Block* prev, Block* next);
+	//! Block of 'block_capacity' rows, or 'capacity' rows if 0
+	Block* new_block(Block* prev, Block* next, size_t block_capacity = 0);
+	void free_block(Block* block);
 };
 
 struct BlockedSpace : IResetable {
@@ -261,11 +364,11 @@ struct BlockedSpace : IResetable {
 	BlockFactory factory;
 
 private:
-	Block* new_block_at_end();
+	Block* new_block_at_end(size_t capacity = 0);
 
 public:
 
-	BlockedSpace(size_t width, size_t capacity) noexcept;
+	BlockedSpace(size_t width, size_t capacity, MemoryAccount* account = nullptr) noexcept;
 
 	void reset() override;
 
@@ -277,6 +380,19 @@ public:
 		}
 
 		ASSERT(b && b->num_free() >= expected_num);
+		b->dirty = std::max(b->dirty, b->num + expected_num);
+		return b;
+	}
+
+	//! Like append(), but a new block is sized to hold 'num' rows, rounded
+	//! up to a MemoryPool::size_class(), see BlockFactory::new_block()
+	Block* reserve(size_t num) {
+		Block* b = tail;
+		if (!b || b->num_free() < num) {
+			b = new_block_at_end(num);
+		}
+
+		b->dirty = std::max(b->dirty, b->num + num);
 		return b;
 	}
 
@@ -305,15 +421,40 @@ public:
 			b = n;
 		}
 	}
+	//! Partitions on hash bits 'shift'.., 'num_partitions' must be a power
+	//! of 2. Counts the rows per partition first, so that each partition
+	//! only grows by one block of the exact size
+	void radix_partition(BlockedSpace** partitions, size_t num_partitions,
+		size_t shift, size_t hash_offset, size_t hash_stride) const;
+
+	//! Appends all blocks to a file in 'dir' and frees them
+	void spill(const std::string& dir);
+
+	//! Reads spilled rows back into blocks, the file is kept
+	void load();
+
+	//! Frees loaded blocks, the rows remain on disk
+	void evict();
+
+	bool is_spilled() const {
+		return !spill_file.empty();
+	}
+
+	//! #Rows in memory and on disk
+	size_t num_rows() const {
+		return (loaded ? 0 : spilled_bytes / factory.width) + size();
+	}
+
+	size_t get_spilled_bytes() const {
+		return spilled_bytes;
+	}
+
 private:
-	static void partition_data(BlockedSpace** partitions, size_t num_partitions,
-		u64* hashes, size_t hash_stride, char* data, size_t width,
-		size_t total_num);
+	std::string spill_file;
+	size_t spilled_bytes = 0;
+	bool loaded = false;
 
 public:
-	void partition(BlockedSpace** partitions, size_t num_partitions,
-		size_t hash_offset, size_t hash_stride) const;
-
 
 	virtual ~BlockedSpace();
 };
@@ -326,12 +467,17 @@ struct ITable : IResetable {
 	const bool m_fully_thread_local;
 	const bool m_flush_to_partitions;
 	const size_t m_row_width;
+	//! Index is an OpenHashIndex instead of chained bucket heads
+	const bool m_open_addressing;
 
 	static constexpr size_t m_block_capacity = 2*1024*1024;
 
 	LogicalMasterTable* m_master_table;
 	std::vector<BlockedSpace*> m_flush_partitions;
 
+	//! Blocks and hash index of this table
+	MemoryAccount m_memory;
+
 	std::vector<BlockedSpace*> m_write_partitions;
 
 	std::mutex mutex;
@@ -340,15 +486,48 @@ struct ITable : IResetable {
 		size_t magic = (size_t)(-1);
 		size_t offset;
 		size_t stride;
+		//! Rows are updated by all threads, aggregates must be atomic
+		bool atomic;
 
-		void init(size_t off, size_t str) {
+		void init(size_t off, size_t str, bool atom = false) {
 			offset = off;
 			stride = str;
+			atomic = atom;
 		}
 	};
 
+	//! Expected #rows (per thread for thread-local tables), the hash index
+	//! is presized to it
+	const size_t m_expected_rows;
+
+	//! Build side of a radix join. bucket_flush scatters the rows of each
+	//! thread into 'm_radix_partitions' partitions on the upper bits of
+	//! the bucket index, then bucket_build inserts a partition at a time.
+	//! Rows and buckets of one partition are meant to fit into cache
+	const bool m_radix_partitioned;
+
+	//! Probe side of a radix join, flushed into the partitions of this
+	//! build side. LogicalMasterTable then reads a partition at a time
+	ITable* m_radix_source = nullptr;
+
+	size_t m_radix_partitions = 0; //!< 0 until the first thread flushed
+	size_t m_radix_shift = 0; //!< Partition of a row is (hash >> shift) % partitions
+	size_t m_radix_count = 0; //!< #Rows over all partitions
+	std::atomic<size_t> m_radix_next_build;
+
+	//! Flush partitions use hash bits from here on. Lower bits index the
+	//! buckets of re-aggregation tables and carry the BucketTag
+	static constexpr size_t kFlushPartitionShift = 40;
+
+	//! Holds the partial result of a global aggregate per thread. Instead
+	//! of flushing, LogicalMasterTable combines the rows of all threads
+	//! once read
+	const bool m_global_aggregate;
+
 	ITable(const char* dbg_name, Query& q, LogicalMasterTable* master_table,
-		size_t row_width, bool fully_thread_local, bool flush_to_part);
+		size_t row_width, bool fully_thread_local, bool flush_to_part,
+		bool open_addressing = false, size_t expected_rows = 0,
+		bool radix_partitioned = false, bool global_aggregate = false);
 
 	virtual ~ITable();
 
@@ -357,6 +536,19 @@ struct ITable : IResetable {
 	virtual void reset_pointers();
 	void reset() override;
 
+	//! Folds the partial global aggregate 'src' into 'dst', generated per
+	//! table
+	virtual void combine_rows(char* dst, const char* src) const;
+
+	//! Sets the MIN/MAX columns of a new global aggregate row to their
+	//! neutral element. Rows start zeroed, which already suits SUM and COUNT
+	virtual void init_global_row(char* row) const;
+
+	//! Allocates the row of the calling thread's partial global aggregate.
+	//! Needs no hash index, the row lives in the thread's own blocks and,
+	//! hence, never shares a cache line with the row of another thread
+	char* new_global_row();
+
 	struct ThreadView {
 		ITable& table;
 		BlockedSpace* space;
@@ -388,7 +580,19 @@ private:
 	u64 hash_index_mask = 0;
 	LargeBuffer* hash_index_buffer = nullptr;
 
+	//! Incremental doubling of a chained index: Bucket i and i + half
+	//! start out sharing the chain of bucket i before the doubling,
+	//! kept in 'hash_index_old', until 'split_buckets()' separates them
+	void** hash_index_old = nullptr;
+	LargeBuffer* hash_index_old_buffer = nullptr;
+	size_t hash_index_split = 0; //!< Next bucket pair to split
+	size_t hash_index_split_end = 0; //!< #Buckets before doubling
+
 public:
+	//! #Bucket pairs split per inserted row, completes the split
+	//! before the next doubling
+	static constexpr size_t kSplitsPerRow = 8;
+
 	size_t hash_index_capacity = 0; //!< #Buckets in 'hash_index_head'
 	size_t hash_index_tuple_counter_seq = 0;
 	std::atomic<size_t> hash_index_tuple_counter_par;
@@ -414,9 +618,36 @@ public:
 		return hash_index_mask;
 	}
 
+	bool is_open_addressing() const {
+		return m_open_addressing;
+	}
+
+	bool is_index_splitting() const {
+		return hash_index_old != nullptr;
+	}
+
 public:
 	bool build_index(bool force, IPipeline* pipeline);
 
+	//! Grows the index of a thread-local chained table before inserting
+	//! 'num' rows. With 'incremental_index_growth', doubles it and splits
+	//! buckets over later inserts, instead of rebuilding from all rows
+	void grow_index(size_t num);
+
+	//! Splits up to 'num' bucket pairs of a pending doubling
+	void split_buckets(size_t num);
+
+	//! Re-aggregation of a flush partition with at most 'num_rows' groups
+	//! starts. Partitions share no keys, so rows of earlier partitions
+	//! need not be found again: Starts over with an empty index, which
+	//! is small enough to stay cached and never grows
+	void begin_merge_partition(size_t num_rows);
+
+private:
+	void alloc_hash_index(size_t num_buckets);
+
+public:
+
 	size_t get_non_flushed_table_count() const {
 		size_t c = 0;
 		for (const auto& write : m_write_partitions) {
@@ -427,8 +658,38 @@ public:
 
 	void flush2partitions();
 
+private:
+	//! Scatters the write partition of the calling thread into its radix
+	//! partitions, which are kept in 'm_flush_partitions', thread-major
+	void radix_partition();
+
+	//! Fixes #partitions and shift from the #rows, once for all threads
+	void init_radix_partitions();
+
+public:
 	void get_read_morsel(Morsel& morsel, MorselContext& ctx, const char* dbg_file = nullptr, int dbg_line = -1);
 
+protected:
+	//! Write partition of the calling thread, for tables shared by all threads
+	BlockedSpace* get_thread_write_partition();
+
+private:
+	//! Hands out the blocks of the calling thread's own table
+	void get_local_read_morsel(Morsel& morsel, MorselContext& ctx);
+
+	//! Hands out rows of all write partitions in chunks of 'morsel_size'
+	void get_shared_read_morsel(Morsel& morsel);
+
+	std::mutex m_scan_mutex;
+	size_t m_scan_partition = 0;
+	Block* m_scan_block = nullptr;
+	size_t m_scan_offset = 0;
+
+	//! Moves the largest flush partitions to disk, until the query uses at
+	//! most 'limit' bytes
+	void spill_flush_partitions(size_t limit);
+
+public:
 	size_t get_row_width() const {
 		return m_row_width;
 	}
@@ -452,18 +713,33 @@ protected:
 
 struct IHashTable : ITable {
 	IHashTable(const char* dbg_name, Query& q, LogicalMasterTable* master_table,
-		size_t row_width, bool fully_thread_local, bool flush_to_part);
+		size_t row_width, bool fully_thread_local, bool flush_to_part,
+		bool open_addressing = false, size_t expected_rows = 0,
+		bool radix_partitioned = false, bool global_aggregate = false);
 
+	//! Shared by all threads, rows are inserted concurrently
+	bool is_shared() const {
+		return !m_fully_thread_local;
+	}
 
 	template<bool PARALLEL>
 	Block* hash_append_prealloc(size_t num) {
+		if (PARALLEL) {
+			// never rebuild under concurrent inserts, the index has been
+			// presized to 'm_expected_rows', otherwise chains just grow
+			return get_thread_write_partition()->append(num);
+		}
+
 		// load factor > 50%?
 		const size_t count = PARALLEL ?
 			hash_index_tuple_counter_par.load() :
 			hash_index_tuple_counter_seq;
 
+		if (UNLIKELY(is_index_splitting())) {
+			split_buckets(kSplitsPerRow * num);
+		}
 		if (UNLIKELY((count + num) * 2 > hash_index_capacity)) {
-			build_index(false, nullptr);
+			grow_index(num);
 		}
 
 		Block* b = m_write_partitions[0]->append(num);
@@ -476,7 +752,7 @@ struct IHashTable : ITable {
 		// proper count
 		if (PARALLEL) {
 			hash_index_tuple_counter_par+=n;
-			ASSERT(false && "untested");
+			b->num+=n;
 		} else {
 			hash_index_tuple_counter_seq+=n;
 			LOG_TRACE("prune:= b=%d +  n=%d\n", b->num, n);
@@ -492,6 +768,15 @@ struct IHashTable : ITable {
 		return hash_append_prune<false>(b, n);
 	}
 
+	//! Makes 'row', allocated by a shared insert and holding its keys and
+	//! hash, visible to all threads. Returns false, if another thread
+	//! has linked a row with the same keys first. 'row' then stays
+	//! unreachable, with all aggregates 0
+	bool shared_link(char* row);
+
+	//! Compares the keys of two rows, generated per table
+	virtual bool keys_equal(const char* a, const char* b) const;
+
 	void reset() override;
 
 	void create_buckets(IPipeline* pipeline) {
@@ -502,6 +787,275 @@ struct IHashTable : ITable {
 		size_t num);
 };
 
+//! Index with linear probing, an alternative to chained bucket heads.
+//! Each slot holds a row pointer and, in the upper bits, a tag of the
+//! row's hash, so most misses never touch a row. A row's 'next' column
+//! stores its slot, from where bucket_next continues probing.
+//! Load factor is at most 70%, see calc_num_buckets().
+struct OpenHashIndex {
+	static constexpr u64 kPointerBits = 48;
+	static constexpr u64 kPointerMask = (1ull << kPointerBits) - 1;
+	static constexpr u64 kConflict = ~0ull;
+
+	//! Re-mixes the hash for the tag. Its upper bits alone are weak for
+	//! small keys, see BucketTag, and are the same for all rows of a flush
+	//! partition, see ITable::kFlushPartitionShift
+	static constexpr u64 kTagMul = 0x9E3779B97F4A7C15ull;
+
+	static u64 tag(u64 hash) {
+		return (hash * kTagMul) & ~kPointerMask;
+	}
+
+	static u64 entry(u64 hash, const char* row) {
+		DBG_ASSERT(!((u64)row & ~kPointerMask));
+		return tag(hash) | (u64)row;
+	}
+
+	//! First row tagged like 'hash' from 'slot' on, 0 if none
+	static u64 probe(const u64* slots, u64 mask, u64 hash, u64 slot) {
+		const u64 t = tag(hash);
+		while (1) {
+			const u64 e = slots[slot];
+			if (!e) {
+				return 0;
+			}
+			if ((e & ~kPointerMask) == t) {
+				return e & kPointerMask;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	static u64 lookup(const u64* slots, u64 mask, u64 hash) {
+		return probe(slots, mask, hash, hash & mask);
+	}
+
+	//! Next candidate after 'row', which was returned by lookup() or next()
+	static u64 next(const u64* slots, u64 mask, const char* row,
+			size_t hash_offset, size_t next_offset) {
+		const u64 hash = *(const u64*)(row + hash_offset);
+		const u64 slot = *(const u64*)(row + next_offset);
+		return probe(slots, mask, hash, (slot + 1) & mask);
+	}
+
+	//! Puts 'row' into the first free slot and returns the slot
+	static u64 insert(u64* slots, u64 mask, u64 hash, const char* row) {
+		u64 slot = hash & mask;
+		while (slots[slot]) {
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = entry(hash, row);
+		return slot;
+	}
+
+	//! Like insert(), but for concurrent inserts into the same index
+	static u64 insert_atomic(u64* slots, u64 mask, u64 hash, const char* row) {
+		const u64 e = entry(hash, row);
+		u64 slot = hash & mask;
+		while (1) {
+			u64 expected = 0;
+			if (!slots[slot] && __atomic_compare_exchange_n(&slots[slot],
+					&expected, e, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				return slot;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	//! Like insert(), but returns kConflict, if a row in [begin, end] with
+	//! the same tag is in the way. This row might be a group with the same
+	//! key, created by the same batch of inserts
+	static u64 insert_new(u64* slots, u64 mask, u64 hash, const char* row,
+			u64 begin, u64 end) {
+		const u64 t = tag(hash);
+		u64 slot = hash & mask;
+		while (1) {
+			const u64 e = slots[slot];
+			if (!e) {
+				break;
+			}
+			const u64 ptr = e & kPointerMask;
+			if ((e & ~kPointerMask) == t && ptr >= begin && ptr <= end) {
+				return kConflict;
+			}
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = entry(hash, row);
+		return slot;
+	}
+};
+
+//! Vector primitives on an OpenHashIndex, used by the kernels
+
+template<typename T>
+sel_t open_bucket_lookup(sel_t* RESTRICT sel, sel_t num, u64* RESTRICT res,
+	const IHashTable* table, const T* RESTRICT hashes)
+{
+	const u64* slots = (const u64*)table->get_hash_index();
+	const u64 mask = table->get_hash_index_mask();
+
+	for (sel_t k=0; k<num; k++) {
+		const sel_t i = sel ? sel[k] : k;
+		res[i] = OpenHashIndex::lookup(slots, mask, hashes[i]);
+	}
+	return num;
+}
+
+template<typename T>
+sel_t open_bucket_next(sel_t* RESTRICT sel, sel_t num, u64* RESTRICT res,
+	const IHashTable* table, const T* RESTRICT rows)
+{
+	const u64* slots = (const u64*)table->get_hash_index();
+	const u64 mask = table->get_hash_index_mask();
+	const size_t hash_offset = table->hash_offset;
+	const size_t next_offset = table->next_offset;
+
+	for (sel_t k=0; k<num; k++) {
+		const sel_t i = sel ? sel[k] : k;
+		res[i] = OpenHashIndex::next(slots, mask, (const char*)rows[i],
+			hash_offset, next_offset);
+	}
+	return num;
+}
+
+template<typename T>
+sel_t open_bucket_insert(sel_t* RESTRICT sel, sel_t num, u64* RESTRICT res,
+	IHashTable* table, const T* RESTRICT hashes)
+{
+	if (!num) {
+		return 0;
+	}
+
+	/* prealloc space for potential new groups */
+	Block* block = table->hash_append_prealloc<false>(num);
+
+	/* to later detect conflicts, determine pointer range inside current block */
+	u64 ptr_begin = 0;
+	u64 ptr_end = 0;
+	table->get_current_block_range((char**)&ptr_begin, (char**)&ptr_end, num);
+
+	u64* slots = (u64*)table->get_hash_index();
+	const u64 mask = table->get_hash_index_mask();
+	const size_t row_width = table->get_row_width();
+	const size_t next_offset = table->next_offset;
+	u64 num_inserted = 0;
+
+	for (sel_t k=0; k<num; k++) {
+		const sel_t i = sel ? sel[k] : k;
+		char* row = (char*)ptr_begin + (row_width*num_inserted);
+		const u64 slot = OpenHashIndex::insert_new(slots, mask, hashes[i], row,
+			ptr_begin, ptr_end);
+		if (slot == OpenHashIndex::kConflict) {
+			res[i] = 0;
+			continue;
+		}
+		*(u64*)(row + next_offset) = slot;
+		res[i] = (u64)row;
+		num_inserted++;
+	}
+
+	table->hash_append_prune<false>(block, num_inserted);
+	return num;
+}
+
+//! Vector primitives on a table shared by all threads. Inserted rows are
+//! allocated in the calling thread's blocks and never conflict. They become
+//! visible with IHashTable::shared_link(), once keys and hash are written
+
+template<typename T>
+sel_t shared_bucket_insert(sel_t* RESTRICT sel, sel_t num, u64* RESTRICT res,
+	IHashTable* table, const T* RESTRICT hashes)
+{
+	(void)hashes;
+	if (!num) {
+		return 0;
+	}
+
+	Block* block = table->hash_append_prealloc<true>(num);
+	const size_t row_width = table->get_row_width();
+	char* row = block->data + (row_width*block->num);
+
+	for (sel_t k=0; k<num; k++) {
+		const sel_t i = sel ? sel[k] : k;
+		res[i] = (u64)row;
+		row += row_width;
+	}
+
+	table->hash_append_prune<true>(block, num);
+	return num;
+}
+
+//! Aggregates on rows of a shared table, see ITable::ColDef::atomic
+
+template<typename T, typename V>
+inline static void
+__atomic_aggr_sum(T* data, const V& val)
+{
+	if constexpr (sizeof(T) <= sizeof(u64)) {
+		__atomic_fetch_add(data, (T)val, __ATOMIC_RELAXED);
+	} else {
+		T old = *data;
+		while (1) {
+			const T prev = __sync_val_compare_and_swap(data, old, old + (T)val);
+			if (prev == old) {
+				return;
+			}
+			old = prev;
+		}
+	}
+}
+
+template<bool MIN, typename T, typename V>
+inline static void
+__atomic_aggr_minmax(T* data, const V& val)
+{
+	const T v = val;
+	T old = *data;
+	while (MIN ? v < old : v > old) {
+		const T prev = __sync_val_compare_and_swap(data, old, v);
+		if (prev == old) {
+			return;
+		}
+		old = prev;
+	}
+}
+
+template<typename R, typename I, typename T>
+sel_t shared_aggr_sum(sel_t* RESTRICT sel, sel_t num, R* RESTRICT res,
+	const I* RESTRICT rows, const T* RESTRICT vals, size_t offset)
+{
+	(void)res;
+	for (sel_t k=0; k<num; k++) {
+		const sel_t i = sel ? sel[k] : k;
+		__atomic_aggr_sum((R*)((char*)rows[i] + offset), vals[i]);
+	}
+	return num;
+}
+
+template<bool MIN, typename R, typename I, typename T>
+sel_t shared_aggr_minmax(sel_t* RESTRICT sel, sel_t num, R* RESTRICT res,
+	const I* RESTRICT rows, const T* RESTRICT vals, size_t offset)
+{
+	(void)res;
+	for (sel_t k=0; k<num; k++) {
+		const sel_t i = sel ? sel[k] : k;
+		__atomic_aggr_minmax<MIN>((R*)((char*)rows[i] + offset), vals[i]);
+	}
+	return num;
+}
+
+template<typename R, typename I>
+sel_t shared_aggr_count(sel_t* RESTRICT sel, sel_t num, R* RESTRICT res,
+	const I* RESTRICT rows, size_t offset)
+{
+	(void)res;
+	for (sel_t k=0; k<num; k++) {
+		const sel_t i = sel ? sel[k] : k;
+		__atomic_aggr_sum((R*)((char*)rows[i] + offset), 1);
+	}
+	return num;
+}
+
 ///// Normalize helpers into function, so we can easily use them from clite:
 
 
@@ -531,14 +1085,31 @@ struct IHashTable : ITable {
 template<typename TABLE, typename INDEX>
 u64 __scalar_bucket_lookup(const TABLE* table, INDEX idx, void** HASH_INDEX, u64 HASH_MASK)
 {
+	if constexpr (TABLE::kOpenAddressing) {
+		return OpenHashIndex::lookup((const u64*)HASH_INDEX, HASH_MASK, idx);
+	}
+
 	const u64 index = idx & HASH_MASK;
 	LOG_TRACE("lookup hash=%p mask=%p idx->%d index=%d\n",
 		HASH_INDEX, HASH_MASK, idx, index);
-	return (u64)(HASH_INDEX[index]);
+	return BucketTag::lookup((u64)HASH_INDEX[index], idx);
 }
 
 #define SCALAR_BUCKET_LOOKUP(TABLE, INDEX, HASH_INDEX, HASH_MASK) __scalar_bucket_lookup(TABLE, INDEX, HASH_INDEX, HASH_MASK)
 
+template<typename TABLE>
+u64 __scalar_bucket_next(const TABLE* table, u64 bucket, void** HASH_INDEX, u64 HASH_MASK)
+{
+	if constexpr (TABLE::kOpenAddressing) {
+		return OpenHashIndex::next((const u64*)HASH_INDEX, HASH_MASK,
+			(const char*)bucket, table->hash_offset, table->next_offset);
+	}
+
+	return ((const typename TABLE::Row*)bucket)->next;
+}
+
+#define SCALAR_BUCKET_NEXT(TABLE, BUCKET, HASH_INDEX, HASH_MASK) __scalar_bucket_next(TABLE, BUCKET, HASH_INDEX, HASH_MASK)
+
 
 #define SCALAR_BUCKET_INSERT(TABLE, INDEX, ROW_TYPE)  \
 	__scalar_bucket_insert<ROW_TYPE>(TABLE, INDEX)
@@ -546,13 +1117,29 @@ u64 __scalar_bucket_lookup(const TABLE* table, INDEX idx, void** HASH_INDEX, u64
 template<typename ROW_TYPE, typename TBL_TYPE, typename IDX_TYPE>
 u64 __scalar_bucket_insert(TBL_TYPE* table, IDX_TYPE idx)
 {
+	if constexpr (TBL_TYPE::kShared) {
+		// linked later by SCALAR_BUCKET_LINK
+		Block* block = table->template hash_append_prealloc<true>(1);
+		char* new_bucket = block->data + (block->width * block->num);
+		table->template hash_append_prune<true>(block, 1);
+		return (u64)new_bucket;
+	}
+
 	Block* block = table->scalar_hash_append_prealloc(1);
 	char* new_bucket = block->data + (block->width * block->num);
 	auto row = (ROW_TYPE*)new_bucket;
-	const u64 index = idx & table->get_hash_index_mask();
 	void** buckets = table->get_hash_index();
-	row->next = (u64)buckets[index];
-	buckets[index] = new_bucket;
+	if constexpr (TBL_TYPE::kOpenAddressing) {
+		row->next = OpenHashIndex::insert((u64*)buckets,
+			table->get_hash_index_mask(), idx, new_bucket);
+		table->scalar_hash_append_prune(block, 1);
+		return (u64)new_bucket;
+	}
+
+	const u64 index = idx & table->get_hash_index_mask();
+	const u64 old = (u64)buckets[index];
+	row->next = BucketTag::ptr(old);
+	buckets[index] = (void*)BucketTag::head(old, (u64)new_bucket, idx);
 	table->scalar_hash_append_prune(block, 1);
 
 	LOG_TRACE("insert hash=%p mask=%p idx->%d index=%d -> new_bucket=%p\n",
@@ -560,14 +1147,13 @@ u64 __scalar_bucket_insert(TBL_TYPE* table, IDX_TYPE idx)
 	return (u64)new_bucket;
 }
 
+#define SCALAR_BUCKET_LINK(TABLE, BUCKET) (TABLE)->shared_link((char*)(BUCKET))
+
 
 template<typename S, typename T>
 void __scalar_output(S& query, T& val)
 {
-	size_t buffer_size = voila_cast<T>::good_buffer_size();;
-	char* str; char buffer[buffer_size];
-	buffer_size = voila_cast<T>::to_cstr(str, &buffer[0], buffer_size, val);
-	query.result.push_col(str, buffer_size);
+	query.result.push(val);
 }
 
 #define SCALAR_OUTPUT(v) __scalar_output(query, v)
@@ -593,8 +1179,28 @@ T __not_null(const T& x)
 #define AGGR_MIN(COL, X) if (COL > X) COL = X;
 #define AGGR_MAX(COL, X) if (COL < X) COL = X;
 
+//! Start value of an accumulator, i.e. the neutral element
+#define AGGR_NEUTRAL_SUM(T) ((T)0)
+#define AGGR_NEUTRAL_COUNT(T) ((T)0)
+#define AGGR_NEUTRAL_MIN(T) std::numeric_limits<T>::max()
+#define AGGR_NEUTRAL_MAX(T) std::numeric_limits<T>::lowest()
+
 #define SCALAR_AGGREGATE(TYPE, COL, VAL) { auto& col = COL; AGGR_##TYPE(col, VAL); LOG_TRACE("type = %s, val = %d, result = %d\n", #TYPE, VAL, col);}
 
+#define AGGR_ATOMIC_SUM(COL, X) __atomic_aggr_sum(&(COL), X);
+#define AGGR_ATOMIC_COUNT(COL, X) __atomic_aggr_sum(&(COL), 1);
+#define AGGR_ATOMIC_MIN(COL, X) __atomic_aggr_minmax<true>(&(COL), X);
+#define AGGR_ATOMIC_MAX(COL, X) __atomic_aggr_minmax<false>(&(COL), X);
+
+//! Like SCALAR_AGGREGATE, but atomic on tables shared by all threads
+#define TABLE_AGGREGATE(TABLE, TYPE, COL, VAL) { auto& col = COL; \
+		if constexpr (std::remove_pointer_t<decltype(TABLE)>::kShared) { \
+			AGGR_ATOMIC_##TYPE(col, VAL); \
+		} else { \
+			AGGR_##TYPE(col, VAL); \
+		} \
+	}
+
 #include "runtime_simd.hpp"
 
 template<typename ROW_TYPE, typename TABLE>
@@ -610,6 +1216,21 @@ inline static void __SIMD_BUCKET_INSERT(_fbuf<u64, 8>& r, TABLE& table, __mmask8
 	}
 	size_t num_inserted = 0;
 
+	if constexpr (std::remove_pointer_t<TABLE>::kShared) {
+		// linked later by SIMD_BUCKET_LINK
+		Block* block = table->template hash_append_prealloc<true>(inum);
+		const size_t row_width = table->get_row_width();
+		char* new_bucket = block->data + (row_width*block->num);
+		for (size_t k=0; k<8; k++) {
+			if (predicate & (1 << k)) {
+				r.a[k] = (u64)new_bucket;
+				new_bucket += row_width;
+			}
+		}
+		table->template hash_append_prune<true>(block, inum);
+		return;
+	}
+
 	/* prealloc space for potential new groups */
 	Block* block = table->scalar_hash_append_prealloc(inum);
 
@@ -622,17 +1243,38 @@ inline static void __SIMD_BUCKET_INSERT(_fbuf<u64, 8>& r, TABLE& table, __mmask8
 	u64* heads = (u64*)table->get_hash_index();
 	const size_t row_width = table->get_row_width();
 
+	if constexpr (std::remove_pointer_t<TABLE>::kOpenAddressing) {
+		for (size_t k=0; k<8; k++) {
+			r.a[k] = 0;
+			if (!(predicate & (1 << k))) {
+				continue;
+			}
+			char* new_bucket = (char*)ptr_begin + (row_width*num_inserted);
+			const u64 slot = OpenHashIndex::insert_new(heads, bucket_mask,
+				indices.a[k], new_bucket, ptr_begin, ptr_end);
+			if (slot == OpenHashIndex::kConflict) {
+				continue;
+			}
+			((ROW_TYPE*)new_bucket)->next = slot;
+			r.a[k] = (u64)new_bucket;
+			num_inserted++;
+		}
+		table->scalar_hash_append_prune(block, num_inserted);
+		return;
+	}
+
 #define A(ALL_TRUE, OFFSET) if (ALL_TRUE || ( predicate & (1 << OFFSET))) { \
 		const u64 idx = indices.a[OFFSET] & bucket_mask; \
 		auto& head = heads[idx]; \
 		u64 result = 0; \
-		bool conflict = head >= ptr_begin && head <= ptr_end; \
+		const u64 first = BucketTag::ptr(head); \
+		bool conflict = first >= ptr_begin && first <= ptr_end; \
 		if (!conflict) { \
 			char* new_bucket = ((char*)ptr_begin + (row_width*num_inserted)); \
 			auto bucket = (ROW_TYPE*)new_bucket;; \
 			result = (u64)bucket; \
-			bucket->next = head; \
-			head = result; \
+			bucket->next = first; \
+			head = BucketTag::head(head, result, indices.a[OFFSET]); \
 			DBG_ASSERT(head); \
 			num_inserted++; \
 		} \
@@ -700,9 +1342,250 @@ inline static void __SIMD_BUCKET_INSERT(_v512& r, TABLE& table, __mmask8 predica
 
 }
 
+//! Probes 8 hashes at once. Lanes finish on an empty slot or a tag match
+inline static __m512i
+__simd_open_probe(__mmask8 active, __m512i slot, __m512i hashes,
+	const u64* slots, u64 bucket_mask)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i one = _mm512_set1_epi64(1);
+	const __m512i vmask = _mm512_set1_epi64(bucket_mask);
+	const __m512i ptr_mask = _mm512_set1_epi64(OpenHashIndex::kPointerMask);
+	const __m512i tag = _mm512_andnot_epi64(ptr_mask,
+		_mm512_mullo_epi64(hashes, _mm512_set1_epi64(OpenHashIndex::kTagMul)));
+
+	__m512i res = zero;
+	while (active) {
+		const __m512i e = _mm512_mask_i64gather_epi64(zero, active, slot, slots, 8);
+		const __mmask8 empty = _mm512_mask_cmpeq_epi64_mask(active, e, zero);
+		const __mmask8 hit = _mm512_mask_cmpeq_epi64_mask(active & ~empty,
+			_mm512_andnot_epi64(ptr_mask, e), tag);
+
+		res = _mm512_mask_and_epi64(res, hit, e, ptr_mask);
+		active &= ~(empty | hit);
+		slot = _mm512_and_epi64(_mm512_add_epi64(slot, one), vmask);
+	}
+	return res;
+}
+
+template<typename TABLE>
+inline static void __SIMD_BUCKET_LOOKUP(_v512& r, const TABLE& table, __mmask8 predicate,
+	const _v512& indices, void** hash_index, u64 hash_mask)
+{
+	(void)table;
+	const __m512i idx = _mm512_and_epi64(_mm512_set1_epi64(hash_mask),
+		SIMD_GET_IVEC(indices));
+
+	if constexpr (std::remove_pointer_t<TABLE>::kOpenAddressing) {
+		_v512_from(r, __simd_open_probe(predicate, idx, SIMD_GET_IVEC(indices),
+			(const u64*)hash_index, hash_mask));
+		return;
+	}
+
+	// see BucketTag::lookup()
+	const __m512i head = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(),
+		predicate, idx, hash_index, sizeof(u64));
+	const __m512i shift = _mm512_add_epi64(_mm512_set1_epi64(BucketTag::kPointerBits),
+		_mm512_and_epi64(_mm512_srli_epi64(SIMD_GET_IVEC(indices), 32),
+			_mm512_set1_epi64(15)));
+	const __mmask8 tagged = _mm512_mask_test_epi64_mask(predicate, head,
+		_mm512_sllv_epi64(_mm512_set1_epi64(1), shift));
+
+	_v512_from(r, _mm512_maskz_and_epi64(tagged, head,
+		_mm512_set1_epi64(BucketTag::kPointerMask)));
+}
+
+template<typename TABLE>
+inline static void __SIMD_BUCKET_NEXT(_v512& r, const TABLE& table, __mmask8 predicate,
+	const _v512& buckets, void** hash_index, u64 hash_mask)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i next = _mm512_mask_i64gather_epi64(zero, predicate,
+		_mm512_add_epi64(SIMD_GET_IVEC(buckets), _mm512_set1_epi64(table->next_offset)),
+		nullptr, 1);
+
+	if constexpr (std::remove_pointer_t<TABLE>::kOpenAddressing) {
+		// 'next' is the slot of the row, continue behind it
+		const __m512i hashes = _mm512_mask_i64gather_epi64(zero, predicate,
+			_mm512_add_epi64(SIMD_GET_IVEC(buckets), _mm512_set1_epi64(table->hash_offset)),
+			nullptr, 1);
+		const __m512i slot = _mm512_and_epi64(_mm512_add_epi64(next, _mm512_set1_epi64(1)),
+			_mm512_set1_epi64(hash_mask));
+
+		_v512_from(r, __simd_open_probe(predicate, slot, hashes,
+			(const u64*)hash_index, hash_mask));
+		return;
+	}
+
+	_v512_from(r, next);
+}
+
+template<typename TABLE>
+inline static void __SIMD_BUCKET_LINK(TABLE& table, __mmask8 predicate,
+	const _fbuf<u64, 8>& buckets)
+{
+	for (size_t k=0; k<8; k++) {
+		if (predicate & (1 << k)) {
+			table->shared_link((char*)buckets.a[k]);
+		}
+	}
+}
+
+template<typename TABLE>
+inline static void __SIMD_BUCKET_LINK(TABLE& table, __mmask8 predicate,
+	const _v512& buckets)
+{
+	for (size_t k=0; k<8; k++) {
+		if (predicate & (1 << k)) {
+			table->shared_link((char*)SIMD_REG_GET(buckets, u64, k));
+		}
+	}
+}
+
+enum SimdAggr {
+	kSimdAggrSum, kSimdAggrMin, kSimdAggrMax
+};
+
+//! Widens a vector of 8 values of type T into 64-bit lanes
+template<typename T>
+inline static __m512i __simd_widen_epi64(const __m512i& x) { return x; }
+
+template<typename T>
+inline static __m512i __simd_widen_epi64(const _v512& x)
+{
+	static_assert(sizeof(T) == 8, "must be 64-bit");
+	return x._iv;
+}
+
+template<typename T>
+inline static __m512i __simd_widen_epi64(const _v256& x)
+{
+	static_assert(sizeof(T) == 4, "must be 32-bit");
+	return std::is_signed<T>::value ?
+		_mm512_cvtepi32_epi64(x._iv) : _mm512_cvtepu32_epi64(x._iv);
+}
+
+template<typename T>
+inline static __m512i __simd_widen_epi64(const _v128& x)
+{
+	static_assert(sizeof(T) == 2, "must be 16-bit");
+	return std::is_signed<T>::value ?
+		_mm512_cvtepi16_epi64(x._iv) : _mm512_cvtepu16_epi64(x._iv);
+}
+
+template<typename T>
+inline static __m512i __simd_widen_epi64(const _fbuf<T, 8>& x)
+{
+	return _mm512_set_epi64(x.a[7], x.a[6], x.a[5], x.a[4],
+		x.a[3], x.a[2], x.a[1], x.a[0]);
+}
+
+template<int OP, bool SIGNED>
+inline static __m512i __simd_aggr_apply(__mmask8 m, const __m512i& a, const __m512i& b)
+{
+	if constexpr (OP == kSimdAggrSum) {
+		return _mm512_mask_add_epi64(a, m, a, b);
+	} else if constexpr (OP == kSimdAggrMin) {
+		return SIGNED ? _mm512_mask_min_epi64(a, m, a, b) : _mm512_mask_min_epu64(a, m, a, b);
+	} else {
+		return SIGNED ? _mm512_mask_max_epi64(a, m, a, b) : _mm512_mask_max_epu64(a, m, a, b);
+	}
+}
+
+//! Vectorized TABLE_AGGREGATE. Lanes hitting the same row are detected
+//! with vpconflictq and pre-reduced in registers, afterwards only the last
+//! lane of each group does gather-update-scatter.
+template<typename COL_TYPE, typename VAL_TYPE, int OP, typename TABLE, typename BUCKETS,
+	typename VALUES>
+inline static void __SIMD_TABLE_AGGREGATE(TABLE& table, __mmask8 predicate,
+	const BUCKETS& buckets, size_t offset, const VALUES& values)
+{
+	static_assert(sizeof(COL_TYPE) == 4 || sizeof(COL_TYPE) == 8, "Only 32/64-bit columns");
+	constexpr bool kSigned = std::is_signed<COL_TYPE>::value;
+
+	const __m512i ptrs = _mm512_add_epi64(__simd_widen_epi64<u64>(buckets),
+		_mm512_set1_epi64(offset));
+	__m512i acc = __simd_widen_epi64<VAL_TYPE>(values);
+
+	(void)table;
+	if constexpr (std::remove_pointer_t<TABLE>::kShared) {
+		// rows can be updated concurrently, stay with scalar atomics
+		u64 p[8];
+		i64 v[8];
+		_mm512_storeu_si512(p, ptrs);
+		_mm512_storeu_si512(v, acc);
+
+		for (size_t k=0; k<8; k++) {
+			if (!(predicate & (1 << k))) {
+				continue;
+			}
+			auto col = (COL_TYPE*)p[k];
+			if constexpr (OP == kSimdAggrSum) {
+				__atomic_aggr_sum(col, (COL_TYPE)v[k]);
+			} else {
+				__atomic_aggr_minmax<OP == kSimdAggrMin>(col, (COL_TYPE)v[k]);
+			}
+		}
+		return;
+	}
+
+	// bit j in lane i is set, iff active lane j < i hits the same row
+	__m512i conflicts = _mm512_maskz_and_epi64(predicate,
+		_mm512_conflict_epi64(ptrs), _mm512_set1_epi64(predicate));
+	__mmask8 has_pred = _mm512_test_epi64_mask(conflicts, conflicts);
+	__mmask8 leaders = predicate;
+
+	if (has_pred) {
+		// every lane is the last one of its group, unless a later lane points to it
+		leaders &= ~(__mmask8)_mm512_reduce_or_epi64(conflicts);
+
+		// link each lane to its closest predecessor in the group and sum up the
+		// chain by pointer jumping, takes log2(8) rounds at most
+		__m512i pred = _mm512_sub_epi64(_mm512_set1_epi64(63),
+			_mm512_lzcnt_epi64(conflicts));
+		while (has_pred) {
+			const __m512i other = _mm512_permutexvar_epi64(pred, acc);
+			const __mmask8 next_has_pred = has_pred & _mm512_movepi64_mask(
+				_mm512_permutexvar_epi64(pred, _mm512_movm_epi64(has_pred)));
+
+			acc = __simd_aggr_apply<OP, kSigned>(has_pred, acc, other);
+			pred = _mm512_mask_permutexvar_epi64(pred, has_pred, pred, pred);
+			has_pred = next_has_pred;
+		}
+	}
+
+	if constexpr (sizeof(COL_TYPE) == 8) {
+		const __m512i old = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(),
+			leaders, ptrs, nullptr, 1);
+		const __m512i upd = __simd_aggr_apply<OP, kSigned>(leaders, old, acc);
+		_mm512_mask_i64scatter_epi64(nullptr, leaders, ptrs, upd, 1);
+	} else {
+		const __m256i old32 = _mm512_mask_i64gather_epi32(_mm256_setzero_si256(),
+			leaders, ptrs, nullptr, 1);
+		const __m512i old = kSigned ?
+			_mm512_cvtepi32_epi64(old32) : _mm512_cvtepu32_epi64(old32);
+		const __m256i upd = _mm512_cvtepi64_epi32(
+			__simd_aggr_apply<OP, kSigned>(leaders, old, acc));
+		_mm512_mask_i64scatter_epi32(nullptr, leaders, ptrs, upd, 1);
+	}
+}
+
+#define SIMD_TABLE_AGGREGATE(TABLE, OP, ROW_TYPE, COL, VAL_TYPE, PREDICATE, BUCKETS, VALUES) \
+	__SIMD_TABLE_AGGREGATE<decltype(ROW_TYPE::col_##COL), VAL_TYPE, OP>( \
+		TABLE, PREDICATE, BUCKETS, SIMD_TABLE_COLUMN_OFFSET(TABLE, COL), VALUES);
+
+#define SIMD_BUCKET_LOOKUP(RESULT, TABLE, PREDICATE, INDICES, HASH_INDEX, HASH_MASK) \
+	__SIMD_BUCKET_LOOKUP(RESULT, TABLE, PREDICATE, INDICES, HASH_INDEX, HASH_MASK)
+
+#define SIMD_BUCKET_NEXT(RESULT, TABLE, PREDICATE, BUCKETS, HASH_INDEX, HASH_MASK) \
+	__SIMD_BUCKET_NEXT(RESULT, TABLE, PREDICATE, BUCKETS, HASH_INDEX, HASH_MASK)
+
 #define SIMD_BUCKET_INSERT(RESULT, ROW_TYPE, TABLE, PREDICATE, INDICES) \
 	__SIMD_BUCKET_INSERT<ROW_TYPE>(RESULT, TABLE, PREDICATE, INDICES);
 
+#define SIMD_BUCKET_LINK(TABLE, PREDICATE, BUCKETS) \
+	__SIMD_BUCKET_LINK(TABLE, PREDICATE, BUCKETS);
+
 
 #include <sstream>
 
@@ -17,9 +17,56 @@ private:
 	std::vector<IResetable*> resetables;
 };
 
+//! Radix partition of each row, (hash >> shift) & mask, with the hashes
+//! 'stride' u64s apart
 void
-runtime_partition(size_t* RESTRICT dest_counts, char** RESTRICT dest_data,
-	size_t num_parts, char* RESTRICT data, size_t width, u64* hashes,
-	size_t num, size_t offset);
+runtime_radix_ids(u16* RESTRICT res, const u64* RESTRICT hashes,
+	size_t stride, size_t num, u64 shift, u64 mask);
+
+//! Appends rows to partitions at 'dest', which must have room for them.
+//! With a large fan-out, rows are combined in cache-line sized buffers
+//! per partition and written by non-temporal stores, instead of touching
+//! one cache line per partition and row
+struct RadixScatter {
+	//! Fan-outs from here on combine writes
+	static constexpr size_t kMinCombineParts = 128;
+
+	RadixScatter(char** dest, size_t num_parts, size_t width);
+
+	//! Appends row i of 'rows' to partition 'ids[i]'
+	void scatter(const char* RESTRICT rows, const u16* RESTRICT ids,
+		size_t num);
+
+	//! Writes the partially filled buffers, before the partitions can be
+	//! read. Leaves 'dest' behind the last row of each partition
+	void finish();
+
+private:
+	static constexpr size_t kLine = 64;
+
+	struct alignas(64) Line {
+		char data[kLine];
+	};
+
+	template<size_t WIDTH>
+	void scatter_direct(const char* RESTRICT rows, const u16* RESTRICT ids,
+		size_t num);
+
+	template<size_t WIDTH>
+	void scatter_combine(const char* RESTRICT rows, const u16* RESTRICT ids,
+		size_t num);
+
+	void write_line(size_t p);
+
+	//! When combining, the cache line currently buffered
+	char** const m_dest;
+	const size_t m_num_parts;
+	const size_t m_width;
+	const bool m_combine;
+
+	std::vector<Line> m_lines;
+	std::vector<size_t> m_fill; //!< Bytes in the line, including 'm_skip'
+	std::vector<size_t> m_skip; //!< Bytes of the line before the partition
+};
 
 #endif
\ No newline at end of file
@@ -458,13 +458,7 @@ VecPipeline::output(sel_t num_rows)
 			switch (expr->type_code) {
 #define F(tpe, _) case TypeCode_##tpe: { \
 						tpe* cast = (tpe*)expr->vec->first; \
-						char* str; \
-						size_t buffer_size = voila_cast<tpe>::good_buffer_size(); \
-						char buffer[buffer_size]; \
-						\
-						buffer_size = voila_cast<tpe>::to_cstr(str, &buffer[0], \
-							buffer_size, sel ? cast[sel[row]] : cast[row]); \
-						query.result.push_col(str, buffer_size); \
+						query.result.push(sel ? cast[sel[row]] : cast[row]); \
 						break; \
 					}
 			
@@ -482,7 +476,11 @@ VecPipeline::output(sel_t num_rows)
 
 
 IFujiAllocatedVector::IFujiAllocatedVector(size_t bytes)
+ : allocated(nullptr), account(MemoryTracker::current_unattributed()), bytes(bytes)
 {
+	if (account) {
+		account->charge(bytes);
+	}
 	allocated = malloc(bytes);
 	SET_FIRST(*this, allocated);
 	alloc = allocated;
@@ -491,4 +489,7 @@ IFujiAllocatedVector::IFujiAllocatedVector(size_t bytes)
 IFujiAllocatedVector::~IFujiAllocatedVector()
 {
 	free(allocated);
+	if (account) {
+		account->release(bytes);
+	}
 }
\ No newline at end of file
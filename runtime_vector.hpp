@@ -392,6 +392,10 @@ protected:
 
 private:
 	void* allocated;
+
+	//! Charged for 'bytes', if allocated while initializing a query
+	MemoryAccount* account;
+	size_t bytes;
 };
 
 template<typename T, size_t VectorSize>
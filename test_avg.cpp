@@ -0,0 +1,38 @@
+#include "runtime.hpp"
+#include "test_check.hpp"
+
+//! Late division of AVG, see voila_div()
+int main() {
+	// non-integral averages round half away from zero
+	CHECK(voila_div((i64)7, (u64)2) == 4);
+	CHECK(voila_div((i64)5, (u64)3) == 2);
+	CHECK(voila_div((i64)4, (u64)3) == 1);
+	CHECK(voila_div((i64)7, (u64)4) == 2);
+	CHECK(voila_div((i64)6, (u64)4) == 2);
+	CHECK(voila_div((i64)5, (u64)4) == 1);
+	CHECK(voila_div((i64)-7, (u64)2) == -4);
+	CHECK(voila_div((i64)-5, (u64)3) == -2);
+	CHECK(voila_div((i64)-4, (u64)3) == -1);
+	CHECK(voila_div((u64)7, (u64)2) == 4);
+	CHECK(voila_div((u32)5, (u64)3) == 2);
+	CHECK(voila_div((i128)-7, (u64)2) == -4);
+	CHECK(voila_div((i128)7, (u64)2) == 4);
+
+	// decimals keep their scale, 10.05 / 2 = 5.025 is 5.03
+	CHECK(voila_div((i64)1005, (u64)2) == 503);
+	// 0.01, 0.02, 0.03, 0.04 average exactly 0.025, the tie is 0.03
+	CHECK(voila_div((i64)10, (u64)4) == 3);
+	// -0.015 is -0.02
+	CHECK(voila_div((i64)-3, (u64)2) == -2);
+
+	// integral averages stay exact
+	CHECK(voila_div((i64)300, (u64)3) == 100);
+	CHECK(voila_div((i64)-300, (u64)3) == -100);
+
+	// empty groups are never output, but do not trap
+	CHECK(voila_div((i64)0, (u64)0) == 0);
+	CHECK(voila_div((i64)5, (u64)0) == 0);
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef H_TEST_CHECK
+#define H_TEST_CHECK
+
+#include <cstdio>
+#include <cstdlib>
+
+//! Like assert(), but also checked in release builds, which define NDEBUG.
+//! Side effects in 'x' always happen
+#define CHECK(x) do { \
+		if (!(x)) { \
+			fprintf(stderr, "%s:%d: Check '%s' failed\n", __FILE__, __LINE__, #x); \
+			abort(); \
+		} \
+	} while (0)
+
+#endif
@@ -0,0 +1,138 @@
+#include "runtime_framework.hpp"
+#include "utils.hpp"
+#include "test_check.hpp"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+static std::string
+make_rows(size_t num, size_t seed)
+{
+	std::vector<std::string> rows;
+	for (size_t i=0; i<num; i++) {
+		rows.push_back(std::to_string(i) + "|" + std::to_string(i % 7) + "|abc");
+	}
+
+	std::mt19937 gen(seed);
+	std::shuffle(rows.begin(), rows.end(), gen);
+
+	std::string r;
+	for (auto& row : rows) {
+		r += row + "\n";
+	}
+	return r;
+}
+
+static void
+test_order()
+{
+	auto a = ResultFingerprint::from_text(make_rows(1000, 1));
+	auto b = ResultFingerprint::from_text(make_rows(1000, 2));
+	auto c = ResultFingerprint::from_text(make_rows(999, 1));
+
+	CHECK(a.rows == 1000);
+	CHECK(a == b);
+	CHECK(a != c);
+
+	// duplicates must not cancel out
+	auto d = ResultFingerprint::from_text("x\nx\n");
+	auto e = ResultFingerprint::from_text("y\ny\n");
+	CHECK(d != e);
+
+	ResultFingerprint s;
+	CHECK(ResultFingerprint::from_string(s, a.to_string()));
+	CHECK(s == a);
+}
+
+static void
+test_query_result()
+{
+	// rows pushed by several threads in any order, match the text
+	QueryResult result;
+	std::vector<std::thread> threads;
+	for (int t=0; t<4; t++) {
+		threads.emplace_back([&, t] () {
+			for (i64 i=999-t; i>=0; i-=4) {
+				result.begin_line();
+				result.push(i);
+				result.push(i % 7);
+				result.push<varchar>(varchar("abc"));
+				result.end_line();
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	CHECK(result.num_rows() == 1000);
+	const auto text = result.finalize();
+	CHECK(result.fingerprint() == ResultFingerprint::from_text(text));
+}
+
+static void
+test_file()
+{
+	char dir[] = "/tmp/test_fingerprint_XXXXXX";
+	const bool created = mkdtemp(dir);
+	CHECK(created);
+	const std::string path = std::string(dir) + "/q.result";
+	const std::string cache = path + ".fingerprint";
+
+	ResultFingerprint fp;
+	bool found;
+	found = ResultFingerprint::from_file(fp, path);
+	CHECK(!found);
+	found = ResultFingerprint::from_file_cached(fp, path);
+	CHECK(!found);
+
+	// same as text, with and without final newline
+	FileUtils::write_string_to_file(path, "a\nb\n\nc");
+	found = ResultFingerprint::from_file(fp, path);
+	CHECK(found);
+	CHECK(fp == ResultFingerprint::from_text("a\nb\n\nc"));
+	CHECK(fp == ResultFingerprint::from_text("a\nb\n\nc\n"));
+
+	const auto rows1 = make_rows(100, 1);
+	FileUtils::write_string_to_file(path, rows1);
+	found = ResultFingerprint::from_file_cached(fp, path);
+	CHECK(found);
+	CHECK(fp == ResultFingerprint::from_text(rows1));
+	CHECK(FileUtils::exists(cache));
+
+	// served from the cache, as long as the result does not change
+	const auto cached = FileUtils::read_string_from_file(cache);
+	FileUtils::write_string_to_file(cache,
+		cached.substr(0, cached.find('\n')+1) + ResultFingerprint().to_string());
+	found = ResultFingerprint::from_file_cached(fp, path);
+	CHECK(found);
+	CHECK(fp == ResultFingerprint());
+
+	// regenerated result invalidates the cache
+	const auto rows2 = make_rows(200, 2);
+	FileUtils::write_string_to_file(path, rows2);
+	found = ResultFingerprint::from_file_cached(fp, path);
+	CHECK(found);
+	CHECK(fp == ResultFingerprint::from_text(rows2));
+
+	// caches without stamp are stale, too
+	FileUtils::write_string_to_file(cache, ResultFingerprint().to_string());
+	found = ResultFingerprint::from_file_cached(fp, path);
+	CHECK(found);
+	CHECK(fp == ResultFingerprint::from_text(rows2));
+
+	unlink(cache.c_str());
+	unlink(path.c_str());
+	rmdir(dir);
+}
+
+int main() {
+	test_order();
+	test_query_result();
+	test_file();
+
+	printf("OK\n");
+	return 0;
+}
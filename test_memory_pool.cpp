@@ -0,0 +1,134 @@
+#include "runtime_struct.hpp"
+#include "runtime_memory.hpp"
+#include "test_check.hpp"
+
+#include <cstring>
+
+static void
+test_size_class()
+{
+	size_t prev = 0;
+	for (size_t size=1; size<1024*1024; size += size/7 + 1) {
+		const size_t c = MemoryPool::size_class(size);
+		CHECK(c >= size);
+		CHECK(c >= prev);
+		CHECK(size <= 64 || c <= size + size/4);
+		CHECK(MemoryPool::size_class(c) == c);
+		prev = c;
+	}
+	CHECK(MemoryPool::size_class(4096) == 4096);
+	CHECK(MemoryPool::size_class(4097) == 5120);
+}
+
+static void
+test_reuse()
+{
+	MemoryPool::clear();
+
+	char* a = (char*)MemoryPool::alloc_zeroed(1000, 0);
+	memset(a, 0xff, 1000);
+	MemoryPool::free(a, 1000, 1000, 0);
+
+	// same size class and node, cleared again
+	char* b = (char*)MemoryPool::alloc_zeroed(1020, 0);
+	CHECK(a == b);
+	for (size_t i=0; i<1024; i++) {
+		CHECK(!b[i]);
+	}
+	MemoryPool::free(b, 1020, 0, 0);
+
+	// other nodes do not get remote memory
+	char* c = (char*)MemoryPool::alloc_zeroed(1000, 1);
+	CHECK(c != a);
+	MemoryPool::free(c, 1000, 0, 1);
+
+	// other size classes neither
+	char* d = (char*)MemoryPool::alloc_zeroed(2000, 0);
+	CHECK(d != a);
+	MemoryPool::free(d, 2000, 0, 0);
+
+	// nothing is cached beyond the limit
+	MemoryPool::clear();
+	MemoryPool::set_limit(0);
+	char* e = (char*)MemoryPool::alloc_zeroed(1000, 0);
+	MemoryPool::free(e, 1000, 0, 0);
+	MemoryPool::set_limit((size_t)4 * 1024 * 1024 * 1024);
+}
+
+static void
+test_accounting()
+{
+	MemoryPool::clear();
+
+	MemoryTracker tracker;
+	MemoryAccount account(&tracker, "blocks");
+	const size_t width = 24;
+
+	{
+		BlockedSpace space(width, 1000, &account);
+
+		// exact reservations fill their size class
+		Block* b = space.reserve(100);
+		CHECK(b->capacity >= 100);
+		CHECK(b->capacity*width <= MemoryPool::size_class(100*width));
+		CHECK(b->capacity*width + width > MemoryPool::size_class(100*width));
+		CHECK(account.current() == b->capacity*width);
+		CHECK(tracker.current() == account.current());
+
+		char* data = b->data;
+		const size_t bytes = b->capacity*width;
+		b->num = 100;
+		space.reset();
+		CHECK(account.current() == 0);
+		CHECK(account.peak() == bytes);
+
+		// a slightly larger reservation reuses the block's memory
+		b = space.reserve(103);
+		CHECK(b->data == data);
+		CHECK(!b->data[0]);
+
+		space.append(b->num_free() + 1);
+		CHECK(account.current() == (b->capacity + b->next->capacity)*width);
+	}
+	CHECK(account.current() == 0);
+	CHECK(tracker.current() == 0);
+}
+
+static void
+test_limit_shrinks_pool()
+{
+	MemoryPool::clear();
+
+	const size_t size = 1024*1024;
+	for (size_t i=0; i<4; i++) {
+		MemoryPool::free(calloc(1, size), size, 0, 0);
+	}
+	CHECK(MemoryPool::get_cached_bytes() == 4*size);
+
+	// cached memory makes room for the query
+	MemoryTracker tracker(3*size);
+	MemoryAccount account(&tracker, "buffer");
+	account.charge(2*size);
+	CHECK(MemoryPool::get_cached_bytes() <= size);
+
+	// and is gone, once the query exceeds its limit
+	bool exceeded = false;
+	try {
+		account.charge(2*size);
+	} catch (const MemoryLimitExceeded&) {
+		exceeded = true;
+	}
+	CHECK(exceeded);
+	CHECK(MemoryPool::get_cached_bytes() == 0);
+	account.release(2*size);
+}
+
+int main() {
+	test_size_class();
+	test_reuse();
+	test_accounting();
+	test_limit_shrinks_pool();
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,156 @@
+#include "runtime_framework.hpp"
+#include "runtime_struct.hpp"
+#include "common/runtime/Database.hpp"
+#include "test_check.hpp"
+
+#include <unordered_map>
+
+//! Group-by on 'key' with SUM(val) and COUNT(*), like the generated
+//! pre-aggregation and re-aggregation tables
+struct AggrTable : IHashTable {
+	struct Row {
+		u64 key;
+		i64 sum;
+		u64 count;
+		u64 hash;
+		u64 next;
+	};
+
+	static constexpr bool kOpenAddressing = false;
+	static constexpr bool kShared = false;
+
+	AggrTable(Query& q, LogicalMasterTable* master)
+	 : IHashTable("aggr", q, master, sizeof(Row), true, master != nullptr)
+	{
+		init();
+	}
+
+	void reset_pointers() override {
+		hash_offset = offsetof(Row, hash);
+		hash_stride = sizeof(Row) / sizeof(u64);
+		next_offset = offsetof(Row, next);
+		next_stride = sizeof(Row) / sizeof(u64);
+	}
+
+	bool keys_equal(const char* a, const char* b) const override {
+		return ((const Row*)a)->key == ((const Row*)b)->key;
+	}
+
+	void aggregate(u64 key, u64 hash, i64 sum, u64 count) {
+		u64 bucket = __scalar_bucket_lookup(this, hash, get_hash_index(),
+			get_hash_index_mask());
+		while (bucket) {
+			auto row = (Row*)bucket;
+			if (row->hash == hash && row->key == key) {
+				break;
+			}
+			bucket = __scalar_bucket_next(this, bucket, get_hash_index(),
+				get_hash_index_mask());
+		}
+
+		if (!bucket) {
+			bucket = __scalar_bucket_insert<Row>(this, hash);
+			auto row = (Row*)bucket;
+			row->key = key;
+			row->hash = hash;
+		}
+
+		auto row = (Row*)bucket;
+		row->sum += sum;
+		row->count += count;
+	}
+};
+
+static u64
+hash_key(u64 key)
+{
+	u64 h = key * 0x9E3779B97F4A7C15ull;
+	return h ^ (h >> 29);
+}
+
+static void
+merge_morsel(AggrTable& target, const Morsel& morsel)
+{
+	auto rows = (const AggrTable::Row*)morsel.data;
+	for (pos_t i=0; i<morsel._num; i++) {
+		target.aggregate(rows[i].key, rows[i].hash, rows[i].sum, rows[i].count);
+	}
+}
+
+//! Two pre-aggregations with the same keys are flushed and merged by one
+//! thread. With 'in_flight', each morsel is merged only after the next one
+//! has been fetched, like with concurrent FSMs
+static void
+test_merge(bool per_partition, bool in_flight)
+{
+	const size_t num_keys = 20000;
+
+	runtime::Database db;
+	QueryConfig cfg(db);
+	cfg.num_threads = 2;
+	Query q(cfg);
+
+	LogicalMasterTable master(q);
+	AggrTable preaggr0(q, &master);
+	AggrTable preaggr1(q, &master);
+	AggrTable target(q, nullptr);
+	master.add_merge_target(target, per_partition);
+	q.reset();
+
+	IPipeline pipeline(q, 0);
+	IPipeline::Scope scope(pipeline);
+
+	size_t t = 0;
+	for (auto preaggr : { &preaggr0, &preaggr1 }) {
+		for (u64 key=0; key<num_keys; key++) {
+			preaggr->aggregate(key, hash_key(key), key + t, 1);
+		}
+		preaggr->flush2partitions();
+		t++;
+	}
+
+	MorselContext ctx(pipeline);
+	Morsel previous;
+	while (1) {
+		Morsel morsel;
+		master.get_read_morsel(morsel, ctx);
+		if (in_flight && previous._num > 0) {
+			merge_morsel(target, previous);
+		}
+		if (morsel._num <= 0) {
+			break;
+		}
+		if (in_flight) {
+			previous = morsel;
+		} else {
+			merge_morsel(target, morsel);
+		}
+	}
+
+	std::vector<bool> seen(num_keys, false);
+	size_t num_groups = 0;
+	target.m_write_partitions[0]->for_each([&] (Block* b) {
+		for (size_t i=0; i<b->num; i++) {
+			auto row = (const AggrTable::Row*)(b->data + i*b->width);
+			CHECK(row->key < num_keys);
+			CHECK(!seen[row->key]);
+			seen[row->key] = true;
+			CHECK(row->count == 2);
+			CHECK(row->sum == (i64)(2*row->key + 1));
+			num_groups++;
+		}
+	});
+	CHECK(num_groups == num_keys);
+}
+
+int main() {
+	// per partition index, each morsel merged before the next
+	test_merge(true, false);
+
+	// rows of a partition are merged after the next partition was claimed
+	test_merge(false, true);
+	test_merge(false, false);
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include "runtime_utils.hpp"
+#include "test_check.hpp"
+
+#include <cstring>
+#include <random>
+
+static const size_t kGuard = 128;
+static const char kGuardByte = (char)0xaa;
+
+static void
+make_row(char* row, size_t width, size_t i)
+{
+	for (size_t k=0; k<width; k++) {
+		row[k] = (char)(i*131 + k*7 + 1);
+	}
+}
+
+//! Scatters 'num_rows' rows into 'num_parts' partitions, each starting
+//! at a different offset into its first cache line
+static void
+test_scatter(size_t num_parts, size_t width, size_t num_rows, size_t seed)
+{
+	std::mt19937 gen(seed);
+
+	std::vector<char> rows(num_rows*width);
+	std::vector<u16> ids(num_rows);
+	std::vector<size_t> counts(num_parts, 0);
+	for (size_t i=0; i<num_rows; i++) {
+		make_row(&rows[i*width], width, i);
+		// skewed, many partitions get no or a single row
+		ids[i] = (gen() % 4) ? gen() % std::max(num_parts/8, (size_t)1) :
+			gen() % num_parts;
+		counts[ids[i]]++;
+	}
+
+	std::vector<std::vector<char>> bufs(num_parts);
+	std::vector<char*> begin(num_parts);
+	std::vector<char*> dest(num_parts);
+	for (size_t p=0; p<num_parts; p++) {
+		auto& buf = bufs[p];
+		buf.resize(64 + 2*kGuard + 64 + counts[p]*width, kGuardByte);
+
+		char* aligned = &buf[0] + (64 - (size_t)&buf[0] % 64) % 64;
+		begin[p] = aligned + kGuard + (p*24 + width) % 64;
+		dest[p] = begin[p];
+	}
+
+	RadixScatter scatter(&dest[0], num_parts, width);
+	for (size_t offset=0; offset<num_rows; ) {
+		const size_t num = std::min(num_rows - offset, (size_t)(gen() % 1024 + 1));
+		scatter.scatter(&rows[offset*width], &ids[offset], num);
+		offset += num;
+	}
+	scatter.finish();
+
+	std::vector<size_t> next(num_parts, 0);
+	std::vector<char> expected(width);
+	for (size_t i=0; i<num_rows; i++) {
+		const size_t p = ids[i];
+		make_row(&expected[0], width, i);
+		CHECK(!memcmp(begin[p] + next[p]*width, &expected[0], width));
+		next[p]++;
+	}
+
+	for (size_t p=0; p<num_parts; p++) {
+		CHECK(dest[p] == begin[p] + counts[p]*width);
+
+		// nothing written around the partition
+		for (char* c = &bufs[p][0]; c < begin[p]; c++) {
+			CHECK(*c == kGuardByte);
+		}
+		for (char* c = dest[p]; c < &bufs[p][0] + bufs[p].size(); c++) {
+			CHECK(*c == kGuardByte);
+		}
+	}
+}
+
+int main() {
+	const size_t k = RadixScatter::kMinCombineParts;
+
+	// fan-outs on both sides of combining writes, widths with and without
+	// specialization, narrower and wider than a cache line
+	for (size_t parts : { (size_t)1, (size_t)2, k/2, k-1, k, k+1, 4*k }) {
+		for (size_t width : { 8, 24, 40, 64, 72, 100, 128, 136, 200 }) {
+			for (size_t rows : { 0, 1, 3, 100, 5000 }) {
+				test_scatter(parts, width, rows, parts*width + rows);
+			}
+		}
+	}
+
+	printf("OK\n");
+	return 0;
+}
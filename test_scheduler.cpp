@@ -0,0 +1,88 @@
+#include "runtime_framework.hpp"
+#include "runtime_scheduler.hpp"
+#include "common/runtime/Database.hpp"
+#include "test_check.hpp"
+
+#include <tbb/parallel_for.h>
+#include <atomic>
+#include <thread>
+
+//! Threads of one query running at the same time, and their peak
+struct Concurrency {
+	std::atomic<size_t> running;
+	std::atomic<size_t> peak;
+
+	Concurrency() : running(0), peak(0) {}
+
+	void enter() {
+		const size_t r = ++running;
+		size_t p = peak;
+		while (r > p && !peak.compare_exchange_weak(p, r)) {
+		}
+	}
+
+	void leave() {
+		running--;
+	}
+};
+
+int main() {
+	const size_t num_slots = 4;
+	const size_t num_queries = 3;
+	const size_t max_threads[num_queries] = { 1, 2, 4 };
+	const size_t morsels = 200;
+
+	runtime::Database db;
+	QueryScheduler scheduler(num_slots);
+
+	std::vector<std::unique_ptr<QueryConfig>> configs;
+	std::vector<std::unique_ptr<Query>> queries;
+	for (size_t i=0; i<num_queries; i++) {
+		configs.emplace_back(new QueryConfig(db));
+		configs.back()->scheduler = &scheduler;
+		configs.back()->num_threads = max_threads[i];
+		configs.back()->priority = i;
+		queries.emplace_back(new Query(*configs.back()));
+	}
+
+	// all queries at the same time, each with more tasks than threads
+	std::vector<Concurrency> concurrency(num_queries);
+	std::vector<std::thread> runners;
+	for (size_t i=0; i<num_queries; i++) {
+		runners.emplace_back([&, i] () {
+			auto& q = *queries[i];
+			scheduler.run(q, [&] () {
+				tbb::parallel_for<size_t>(0, morsels, 1, [&] (size_t m) {
+					IPipeline pipeline(q, m % max_threads[i]);
+
+					concurrency[i].enter();
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+					scheduler.next_morsel(pipeline, m);
+					concurrency[i].leave();
+
+					scheduler.next_morsel(pipeline, -1);
+				});
+			});
+		});
+	}
+	for (auto& r : runners) {
+		r.join();
+	}
+
+	for (size_t i=0; i<num_queries; i++) {
+		CHECK(concurrency[i].peak >= 1);
+		CHECK(concurrency[i].peak <= max_threads[i]);
+
+		// invalid morsels are not counted
+		const auto stats = scheduler.get_stats(*queries[i]);
+		CHECK(stats.morsels == morsels);
+		CHECK(stats.tuples == morsels*(morsels-1)/2);
+		CHECK(stats.latency_ms > 0.0);
+		CHECK(stats.get_throughput() > 0.0);
+	}
+
+	queries.clear();
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,227 @@
+#include "runtime_framework.hpp"
+#include "runtime_struct.hpp"
+#include "common/runtime/Database.hpp"
+#include "test_check.hpp"
+
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+//! Group-by on 'key' with SUM(val), COUNT(*) and MIN(val), shared by all
+//! threads like generated tables with kShared
+struct SharedTable : IHashTable {
+	struct Row {
+		u64 key;
+		i64 sum;
+		u64 count;
+		i64 min;
+		u64 hash;
+		u64 next;
+	};
+
+	static constexpr bool kOpenAddressing = false;
+	static constexpr bool kShared = true;
+
+	SharedTable(Query& q, size_t expected_rows)
+	 : IHashTable("shared", q, nullptr, sizeof(Row), false, false, false,
+	 	expected_rows, false, false)
+	{
+		init();
+	}
+
+	void reset_pointers() override {
+		hash_offset = offsetof(Row, hash);
+		hash_stride = sizeof(Row) / sizeof(u64);
+		next_offset = offsetof(Row, next);
+		next_stride = sizeof(Row) / sizeof(u64);
+	}
+
+	bool keys_equal(const char* a, const char* b) const override {
+		return ((const Row*)a)->key == ((const Row*)b)->key;
+	}
+};
+
+static u64
+hash_key(u64 key)
+{
+	// few distinct bucket tags, so that chains are long and links collide
+	return key * 0x9E3779B97F4A7C15ull;
+}
+
+static u64
+find(SharedTable& table, u64 key, u64 hash)
+{
+	u64 bucket = __scalar_bucket_lookup(&table, hash, table.get_hash_index(),
+		table.get_hash_index_mask());
+	while (bucket) {
+		auto row = (const SharedTable::Row*)bucket;
+		if (row->hash == hash && row->key == key) {
+			return bucket;
+		}
+		bucket = __scalar_bucket_next(&table, bucket, table.get_hash_index(),
+			table.get_hash_index_mask());
+	}
+	return 0;
+}
+
+static u64
+key_of(size_t i, size_t num_keys)
+{
+	return ((i / 2) * 13) % num_keys;
+}
+
+static i64
+value_of(u64 key, size_t thread, size_t i)
+{
+	return (i64)(key * 7 + thread * 3 + i % 5) - 100;
+}
+
+//! Aggregates a batch like the generated code: look up, aggregate found
+//! rows, insert and link the rest, then look these up again. Rows, which
+//! lose the link against an equal key, stay at count 0
+static void
+aggregate_batch(SharedTable& table, const u64* keys, const i64* vals, sel_t num)
+{
+	std::vector<u64> hashes(num);
+	std::vector<u64> rows(num);
+	std::vector<sel_t> pending(num);
+	std::vector<sel_t> found(num);
+	std::vector<sel_t> missing(num);
+
+	for (sel_t i=0; i<num; i++) {
+		hashes[i] = hash_key(keys[i]);
+		pending[i] = i;
+	}
+
+	sel_t num_pending = num;
+	while (num_pending) {
+		sel_t num_found = 0;
+		sel_t num_missing = 0;
+		for (sel_t k=0; k<num_pending; k++) {
+			const sel_t i = pending[k];
+			rows[i] = find(table, keys[i], hashes[i]);
+			if (rows[i]) {
+				found[num_found++] = i;
+			} else {
+				missing[num_missing++] = i;
+			}
+		}
+
+		shared_aggr_sum<i64>(&found[0], num_found, nullptr, &rows[0], vals,
+			offsetof(SharedTable::Row, sum));
+		shared_aggr_count<u64>(&found[0], num_found, nullptr, &rows[0],
+			offsetof(SharedTable::Row, count));
+		shared_aggr_minmax<true, i64>(&found[0], num_found, nullptr, &rows[0],
+			vals, offsetof(SharedTable::Row, min));
+
+		shared_bucket_insert(&missing[0], num_missing, &rows[0], &table,
+			&hashes[0]);
+		for (sel_t k=0; k<num_missing; k++) {
+			const sel_t i = missing[k];
+			auto row = (SharedTable::Row*)rows[i];
+			row->key = keys[i];
+			row->min = std::numeric_limits<i64>::max();
+			row->hash = hashes[i];
+			table.shared_link((char*)row);
+		}
+
+		std::copy(missing.begin(), missing.begin() + num_missing, pending.begin());
+		num_pending = num_missing;
+	}
+}
+
+int main() {
+	const size_t num_threads = 8;
+	const size_t num_keys = 5000;
+	const size_t rows_per_thread = 100000;
+	const sel_t vsize = 256;
+
+	runtime::Database db;
+	QueryConfig cfg(db);
+	cfg.num_threads = num_threads;
+	Query q(cfg);
+
+	// index much too small, chains grow under concurrent inserts
+	SharedTable table(q, 64);
+	q.reset();
+
+	std::atomic<size_t> started(0);
+	std::vector<std::thread> threads;
+	for (size_t t=0; t<num_threads; t++) {
+		threads.emplace_back([&, t] () {
+			IPipeline pipeline(q, t);
+			IPipeline::Scope scope(pipeline);
+
+			started++;
+			while (started < num_threads) {
+				std::this_thread::yield();
+			}
+
+			// all threads start with the same keys, which all are new. Each
+			// key comes twice per batch, so that one of both inserts loses
+			std::vector<u64> keys(vsize);
+			std::vector<i64> vals(vsize);
+			for (size_t offset=0; offset<rows_per_thread; offset += vsize) {
+				const sel_t num = std::min((size_t)vsize, rows_per_thread - offset);
+				for (sel_t k=0; k<num; k++) {
+					const size_t i = offset + k;
+					keys[k] = key_of(i, num_keys);
+					vals[k] = value_of(keys[k], t, i);
+				}
+				aggregate_batch(table, &keys[0], &vals[0], num);
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	struct Expected {
+		i64 sum = 0;
+		u64 count = 0;
+		i64 min = std::numeric_limits<i64>::max();
+		bool seen = false;
+	};
+	std::unordered_map<u64, Expected> expected;
+	for (size_t t=0; t<num_threads; t++) {
+		for (size_t i=0; i<rows_per_thread; i++) {
+			const u64 key = key_of(i, num_keys);
+			const i64 val = value_of(key, t, i);
+			auto& e = expected[key];
+			e.sum += val;
+			e.count++;
+			e.min = std::min(e.min, val);
+		}
+	}
+
+	// each group exactly once, losing rows are filtered by their count
+	size_t num_rows = 0;
+	size_t num_groups = 0;
+	for (auto part : table.m_write_partitions) {
+		part->for_each([&] (Block* b) {
+			for (size_t i=0; i<b->num; i++) {
+				auto row = (const SharedTable::Row*)(b->data + i*b->width);
+				num_rows++;
+				if (!row->count) {
+					CHECK(!row->sum);
+					continue;
+				}
+
+				auto it = expected.find(row->key);
+				CHECK(it != expected.end());
+				auto& e = it->second;
+				CHECK(!e.seen);
+				e.seen = true;
+				CHECK(row->sum == e.sum);
+				CHECK(row->count == e.count);
+				CHECK(row->min == e.min);
+				num_groups++;
+			}
+		});
+	}
+	CHECK(num_groups == expected.size());
+	CHECK(num_rows > num_groups);
+
+	printf("OK %zu groups, %zu lost inserts\n", num_groups, num_rows - num_groups);
+	return 0;
+}
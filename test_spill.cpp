@@ -0,0 +1,121 @@
+#include "runtime_struct.hpp"
+#include "runtime_memory.hpp"
+#include "test_check.hpp"
+
+#include <unistd.h>
+
+struct Row {
+	u64 key;
+	u64 val;
+};
+
+static void
+append_rows(BlockedSpace& space, u64 begin, u64 end)
+{
+	for (u64 i=begin; i<end; i++) {
+		Block* b = space.append(1);
+		Row* row = (Row*)(b->data + b->num*b->width);
+		row->key = i;
+		row->val = i*3;
+		b->num++;
+	}
+}
+
+//! All rows [0, num) in order
+static bool
+check_rows(const BlockedSpace& space, u64 num)
+{
+	u64 i = 0;
+	bool ok = true;
+	space.for_each([&] (auto blk) {
+		const Row* rows = (const Row*)blk->data;
+		for (size_t k=0; k<blk->num; k++, i++) {
+			ok &= rows[k].key == i && rows[k].val == i*3;
+		}
+	});
+	return ok && i == num;
+}
+
+static void
+test_round_trip(const std::string& dir)
+{
+	MemoryTracker tracker;
+	MemoryAccount account(&tracker, "spill");
+	BlockedSpace space(sizeof(Row), 100, &account);
+
+	// spilled space keeps counting its rows, but holds no memory
+	append_rows(space, 0, 250);
+	CHECK(account.current() > 0);
+	space.spill(dir);
+	CHECK(space.is_spilled());
+	CHECK(!space.head);
+	CHECK(space.num_rows() == 250);
+	CHECK(space.get_spilled_bytes() == 250*sizeof(Row));
+	CHECK(account.current() == 0);
+
+	// rows flushed later are appended to the file
+	append_rows(space, 250, 300);
+	CHECK(space.num_rows() == 300);
+	space.spill(dir);
+	CHECK(space.num_rows() == 300);
+	CHECK(account.current() == 0);
+
+	space.load();
+	CHECK(space.num_rows() == 300);
+	CHECK(check_rows(space, 300));
+	CHECK(account.current() > 0);
+
+	// loading again does not duplicate
+	space.load();
+	CHECK(check_rows(space, 300));
+
+	space.evict();
+	CHECK(!space.head);
+	CHECK(space.num_rows() == 300);
+	CHECK(account.current() == 0);
+
+	// spilling loaded rows does not write them twice
+	space.load();
+	space.spill(dir);
+	CHECK(space.get_spilled_bytes() == 300*sizeof(Row));
+	space.load();
+	CHECK(check_rows(space, 300));
+	space.evict();
+
+	// reset drops the file
+	space.reset();
+	CHECK(!space.is_spilled());
+	CHECK(space.num_rows() == 0);
+	CHECK(account.current() == 0);
+}
+
+static void
+test_bad_dir()
+{
+	BlockedSpace space(sizeof(Row), 100);
+	append_rows(space, 0, 10);
+
+	bool thrown = false;
+	try {
+		space.spill("/nonexistent/spill/dir");
+	} catch (std::runtime_error&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+int main() {
+	char dir[] = "/tmp/test_spill_XXXXXX";
+	const bool created = mkdtemp(dir);
+	CHECK(created);
+
+	test_round_trip(dir);
+	test_bad_dir();
+
+	// all spill files are gone
+	const int removed = rmdir(dir);
+	CHECK(!removed);
+
+	printf("OK\n");
+	return 0;
+}
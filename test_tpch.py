@@ -8,27 +8,42 @@ num_timeout = 0
 num_fail = 0
 num_success = 0
 
+def count_result(r):
+	global num_timeout, num_fail, num_success
+
+	if r is None:
+		print("Timed out")
+		num_timeout = num_timeout + 1
+	else:
+		(success, stdout, stderr) = r
+		if success:
+			num_success = num_success + 1
+		else:
+			print("Failed")
+			num_fail = num_fail + 1
+
 def test_tpch(no_run=None):
 	queries = build_config.get_all_queries()
 	flavors = build_config.get_all_flavors()
 	scale_factor = 1
 
-	global num_timeout, num_fail, num_success
-
 	for flavor in flavors:
 		for query in queries:
-			r = build_config.run(flavor=flavor, queries=query,
-				scale_factor=scale_factor, no_run=no_run)
-			if r is None:
-				print("Timed out")
-				num_timeout = num_timeout + 1
-			else:
-				(success, stdout, stderr) = r
-				if success:
-					num_success = num_success + 1
-				else:
-					print("Failed")
-					num_fail = num_fail + 1
+			count_result(build_config.run(flavor=flavor, queries=query,
+				scale_factor=scale_factor, no_run=no_run))
+
+	# re-aggregation, while concurrent FSMs still hold rows of the
+	# previously claimed flush partition
+	for query in ["q1", "q9"]:
+		count_result(build_config.run(flavor="fuji", queries=query,
+			scale_factor=scale_factor, no_run=no_run, num_threads=4,
+			default_blend="computation_type=scalar,concurrent_fsms=4,prefetch=1"))
+
+	# tiered execution fails, unless the optimized tier is built and
+	# switched to
+	for flavor in flavors:
+		count_result(build_config.run(flavor=flavor, queries="q9",
+			scale_factor=scale_factor, no_run=no_run, hot_runs=3, tiered=True))
 
 
 def main():
@@ -132,6 +132,7 @@ TypingPass::type_function(ExprPtr& expr)
 
 				auto cast_const = [&] (auto& old) -> ExprPtr {
 					auto r = std::make_shared<Const>(old->fun);
+					r->param = old->param;
 					r->props = old->props;
 					r->props.type.arity[0] = cover;
 					return r;
@@ -257,13 +258,25 @@ TypingPass::type_function(ExprPtr& expr)
 			return type_col_min_max(
 				(double)config.max_card * a.props.type.arity[0].dmin,
 				(double)config.max_card * a.props.type.arity[0].dmax);
-		} else if (!f.compare("aggr_min") || !f.compare("aggr_max")) {
-			ASSERT(s.args.size() == 3 && "must be ternary");
-			auto& a = *s.args[2];
+		} else if (!f.compare("aggr_min") || !f.compare("aggr_max") ||
+				!f.compare("aggr_gmin") || !f.compare("aggr_gmax")) {
+			size_t data_idx;
+
+			if (!f.compare("aggr_min") || !f.compare("aggr_max")) {
+				data_idx = 2;
+				ASSERT(s.args.size() == 3 && "must be ternary");
+			} else {
+				data_idx = 1;
+				ASSERT(s.args.size() == 2 && "must be binary");
+			}
+			auto& a = *s.args[data_idx];
 			ASSERT(a.props.type.arity.size() == 1 && "must be scalar");
 
-			return type_col_min_max(a.props.type.arity[0].dmin,
-				a.props.type.arity[0].dmax);
+			// same type as the first value, which initializes new groups
+			auto t = TypeProps { TypeProps::Category::Tuple, { a.props.type.arity[0] } };
+			s.args[0]->props.type = t;
+
+			return type_col(t);
 		} else if (!f.compare("read") || !f.compare("gather")) {
 			std::string col;
 			size_t res = s.get_table_column_ref(col);
@@ -383,6 +396,18 @@ TypingPass::type_function(ExprPtr& expr)
 	ARITH2_INFIX(sub, -)
 	ARITH2_INFIX(mul, *)
 
+	// rounded division for AVG, see voila_div(). The divisor is a count
+	// and never negative. Keeps the type of the dividend, which always fits
+	if (!f.compare("div")) {
+		return binary_op(false, [&] (auto alo, auto ahi, auto blo, auto bhi) {
+			(void)blo; (void)bhi;
+			const double lo = std::min(alo, 0.0);
+			const double hi = std::max(ahi, 0.0);
+			return TypeProps { TypeProps::Category::Tuple,
+				{ {lo, hi, s.args[0]->props.type.arity[0].type} } };
+		});
+	}
+
 	COMPARE_INFIX(le, <=)
 	COMPARE_INFIX(lt, <)
 	COMPARE_INFIX(ge, >=)
@@ -466,8 +491,25 @@ TypingPass::on_expression(LolepopCtx& ctx, ExprPtr& expr)
 	 	{
 			long long cval;
 			bool is_cardinal = parse_cardinal(cval, s.fun);
+			ASSERT((is_cardinal || !s.is_param()) && "Parameters must be integers");
 
-			if (is_cardinal) {
+			if (is_cardinal && s.is_param()) {
+				// any value of the default's type can be bound later,
+				// prefer signed types, like most columns
+				const double v = cval;
+				const auto type = type_from_minmax(std::min(v, -1.0), v);
+				double dmin = v;
+				double dmax = v;
+#define TYPE(typ, utyp, issigned, _) \
+				if (!type.compare(#typ)) { \
+					dmin = std::numeric_limits<typ>::min(); \
+					dmax = std::numeric_limits<typ>::max(); \
+				}
+
+				TYPE_EXPAND_VOILA_CAST(TYPE, 0)
+#undef TYPE
+				t = TypeProps {TypeProps::Category::Tuple, {{ dmin, dmax, type }}};
+			} else if (is_cardinal) {
 				const double v = cval;
 				t = TypeProps {TypeProps::Category::Tuple, {{ v, v, type_from_minmax(v, v) }}};
 			} else {
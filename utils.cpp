@@ -35,6 +35,19 @@ FileUtils::exists(const std::string& file)
 	return f.good();
 }
 
+#include <sys/stat.h>
+
+std::string
+FileUtils::get_stamp(const std::string& file)
+{
+	struct stat st;
+	if (stat(file.c_str(), &st)) {
+		return "";
+	}
+	return std::to_string(st.st_size) + " " + std::to_string(st.st_mtim.tv_sec) +
+		"." + std::to_string(st.st_mtim.tv_nsec);
+}
+
 #include <functional>
 
 static void
@@ -142,6 +142,8 @@ struct FileUtils {
 	static void append_string_to_file(const std::string& path, const std::string& data);
 	static std::string read_string_from_file(const std::string& path);
 	static bool exists(const std::string& file);
+	//! Size and modification time of 'file' as string, empty if it does not exist
+	static std::string get_stamp(const std::string& file);
 };
 
 struct ConfigParser {
@@ -162,7 +162,8 @@ Expression::is_aggr(bool* out_global) const
 	bool global = false;
 	auto& n = fun;
 
-	global = str_in_strings(n, {"aggr_gcount", "aggr_gsum", "aggr_gconst1"});
+	global = str_in_strings(n, {"aggr_gcount", "aggr_gsum", "aggr_gmin",
+		"aggr_gmax", "aggr_gconst1"});
 	if (global || str_in_strings(n, {"aggr_count", "aggr_sum", "aggr_min", "aggr_max"})) {
 		if (out_global) {
 			*out_global = global;
@@ -386,6 +387,7 @@ Expression::clone() const
 {
 	ExprPtr r = std::make_shared<Expression>(type, fun, args, pred);
 	r->props = props;
+	r->param = param;
 	return r;
 }
 
@@ -149,6 +149,10 @@ struct Expression : Node {
 	std::vector<std::shared_ptr<Expression>> args;
 	std::shared_ptr<Expression> pred;
 
+	//! Constants only: Name of the query parameter read at runtime, 'fun'
+	//! only holds the value used for typing
+	std::string param;
+
 	bool is_get_pos() const;
 	bool is_get_morsel() const;
 
@@ -160,6 +164,10 @@ struct Expression : Node {
 		return type == Constant;
 	}
 
+	bool is_param() const {
+		return type == Constant && !param.empty();
+	}
+
 	bool is_cast() const;
 	bool is_select() const;
 	size_t get_table_column_ref(std::string& tbl_col) const; 
@@ -234,6 +242,11 @@ struct Pipeline {
 
 	bool tag_interesting = true; //!< To focus exploration
 
+	//! Earlier pipelines that have to finish before this one can start.
+	//! If not known, the pipeline depends on all earlier pipelines
+	std::vector<size_t> dependencies;
+	bool dependencies_known = false;
+
 	// Pipeline(std::vector<Lolepop*>& lolepops) : lolepops(lolepops) {}
 };
 
@@ -248,6 +261,11 @@ struct DCol {
 	const std::string source; // only for columns of BaseTables
 	const Modifier mod;
 
+	//! Global aggregates only: How the partial results of two threads
+	//! combine, "sum", "min", "max", or "count", which also tells empty
+	//! results apart
+	std::string combine;
+
 	DCol(const std::string& name, const std::string& source = "", Modifier mod = Modifier::kValue)
 		: name(name), source(source), mod(mod){
 
@@ -265,6 +283,12 @@ struct DataStructure {
 	static constexpr Flags kThreadLocal = 1 << 1;
 	static constexpr Flags kReadAfterWrite = 1 << 2;
 	static constexpr Flags kFlushToMaster = 1 << 3;
+	//! Index by linear probing instead of chained bucket heads
+	static constexpr Flags kOpenAddressing = 1 << 4;
+	//! Build side of a radix join, bucket_flush partitions the rows
+	static constexpr Flags kRadixPartitioned = 1 << 5;
+	//! One row per thread, combined when read, see ITable::m_global_aggregate
+	static constexpr Flags kGlobalAggregate = 1 << 6;
 	static constexpr Flags kDefault = 0;
 
 	static std::string type_to_str(Type t);
@@ -276,6 +300,17 @@ struct DataStructure {
 
 	const std::vector<DCol> cols;
 
+	//! Estimated #rows, per thread for thread-local tables. 0 if unknown.
+	//! Presizes the hash index
+	size_t cardinality = 0;
+
+	//! Flushed into the partitions of this kRadixPartitioned table
+	std::string partitioned_like;
+
+	//! Re-aggregates the flush partitions of this kFlushToMaster table,
+	//! one partition at a time
+	std::string merges;
+
 	DataStructure(const std::string& name, const Type& type, const Flags& flags,
 		const std::vector<DCol>& cols, const std::string& source = "")
 		: name(name), source(source), type(type), flags(flags), cols(cols) {
@@ -485,6 +520,20 @@ struct AggrGSum : Effect {
 	: Effect(std::make_shared<Fun>("aggr_gsum", ExprList {col, val}, pred)) { }	
 };
 
+struct AggrGMin : Effect {
+	AggrGMin(const ExprPtr& col,
+		const ExprPtr& val,
+		const ExprPtr& pred)
+	: Effect(std::make_shared<Fun>("aggr_gmin", ExprList {col, val}, pred)) { }
+};
+
+struct AggrGMax : Effect {
+	AggrGMax(const ExprPtr& col,
+		const ExprPtr& val,
+		const ExprPtr& pred)
+	: Effect(std::make_shared<Fun>("aggr_gmax", ExprList {col, val}, pred)) { }
+};
+
 struct AggrGCount : Effect {
 	AggrGCount(const ExprPtr& col,
 		const ExprPtr& pred)